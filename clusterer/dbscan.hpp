@@ -39,19 +39,17 @@ namespace cluster
              *
              * \param data Data array 
              * \param eps Epsilon distance parameter of the DBSCAN algorithm 
-             * \param min_pts Minimal number of points for the DBSCAN algorithm
-             * \param dim Dimention of the data */
-            dbscan(std::shared_ptr<const std::vector<float>> data, 
-                    const float eps, const int min_pts, const int dim) :
-                _data(data), _eps(eps), _min_pts(min_pts), _dim(dim) {}
+             * \param min_pts Minimal number of points for the DBSCAN algorithm */
+            dbscan(std::shared_ptr<const dataset> data, 
+                    const float eps, const int min_pts) :
+                _data(data), _eps(eps), _min_pts(min_pts), _dim(data->dim()) {}
 
             /*! \brief Constructs another dbscan based on the others dbscan
              * data, tree and parameters */
             dbscan(const dbscan& other);
 
             /*! \brief Fits the new data to the dbscan clusterer */
-            inline void fit(std::shared_ptr<const std::vector<float>> data, 
-                    const int dim);
+            inline void fit(std::shared_ptr<const dataset> data);
 
             /*! \brief Set epsilon value for the DBSCAN algorithm */
             inline float& eps() {return _eps;}
@@ -60,7 +58,7 @@ namespace cluster
             /*! \brief Set data dimention */
             inline int& dim() {return _dim;}
             /*! \brief Set data */
-            inline std::shared_ptr<const std::vector<float>>& data() {return _data;}
+            inline std::shared_ptr<const dataset>& data() {return _data;}
 
             /*! \brief Get epsilon value of the DBSCAN algorithm */
             inline const float& eps() const {return _eps;}
@@ -69,7 +67,7 @@ namespace cluster
             /*! \brief Get data dimention */
             inline const int& dim() const {return _dim;}
             /*! \brief Get data  */
-            inline const std::shared_ptr<const std::vector<float>>& data() const {return _data;}
+            inline const std::shared_ptr<const dataset>& data() const {return _data;}
 
         protected:
             /* Classical DBSCAN Parameters */
@@ -78,7 +76,7 @@ namespace cluster
 
             int _dim;     /*!< Data's dimention */
 
-            std::shared_ptr<const std::vector<float>> _data; /*!< Vector containing data */
+            std::shared_ptr<const dataset> _data; /*!< Points to cluster */
     };
 };
 
@@ -95,11 +93,10 @@ inline cluster::dbscan::dbscan(const cluster::dbscan& other) :
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void cluster::dbscan::fit(std::shared_ptr<const std::vector<float>> 
-        data, const int dim)
+inline void cluster::dbscan::fit(std::shared_ptr<const dataset> data)
 {
     _data = data;
-    _dim = dim;
+    _dim = data->dim();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
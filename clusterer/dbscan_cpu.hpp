@@ -28,64 +28,67 @@
 namespace cluster {
 namespace cpu
 {
-    /*! \brief Class for applying DBSCAN clustering algorithm to data */
-    class dbscan : public cluster::dbscan
+    /*! \brief Class for applying DBSCAN clustering algorithm to data
+     *
+     * M is the metric functor of the vp-tree, see metric::cpu::euclidean_t
+     * */
+    template <typename M>
+    class dbscan_t : public cluster::dbscan
     {
         public:
             /*! \brief Constructs new empty dbscan clusterer */
-            dbscan();
+            dbscan_t();
 
             /*! \brief Constructor of the clusterer 
              *
              * \param data Data array 
              * \param eps Epsilon distance parameter of the DBSCAN algorithm 
              * \param min_pts Minimal number of points for the DBSCAN algorithm
-             * \param dim Dimention of the data 
-             * \param metric Metric function to use for the DBSCAN algorithm */
-            dbscan(std::shared_ptr<const std::vector<float>> data, 
-                    const float eps, const int min_pts, const int dim, 
-                    metric::cpu::metric_f metric = metric::cpu::euclidean);
+             * \param metric Metric to use for the DBSCAN algorithm */
+            dbscan_t(std::shared_ptr<const dataset> data, 
+                    const float eps, const int min_pts, 
+                    M metric = M());
 
             /*! \brief Constructs new dbscan clusterer based on an existing tree */
-            dbscan(std::shared_ptr<const std::vector<float>> data, 
-                    const float eps, const int min_pts, const int dim, 
-                    const tree::cpu::vp_tree& tree);
+            dbscan_t(std::shared_ptr<const dataset> data, 
+                    const float eps, const int min_pts, 
+                    const tree::cpu::vp_tree_t<M>& tree);
 
             /*! \brief Constructs copy dbscan from another dbscan with same
              * parameters, data and tree */
-            dbscan(const dbscan& other);
+            dbscan_t(const dbscan_t& other);
 
             /*! \brief Fits the new data to the dbscan clusterer */
-            inline void fit(std::shared_ptr<const std::vector<float>> data, int dim);
+            inline void fit(std::shared_ptr<const dataset> data);
 
             /*! \brief uses the fitted data to produce the assignements */
             inline void predict(std::vector<int>& assignements) const;
 
-            /*! \brief Get the metric function used in the tree */
-            inline const metric::cpu::metric_f& metric() const {return _tree.metric();}
+            /*! \brief Get the metric used in the tree */
+            inline const M& metric() const {return _tree.metric();}
 
-            /*! \brief Sets the metric function used in the tree */
-            inline metric::cpu::metric_f& metric() {return _tree.metric();}
+            /*! \brief Sets the metric used in the tree */
+            inline M& metric() {return _tree.metric();}
 
             /*! \brief Gets the vp-tree */
-            inline const tree::cpu::vp_tree& tree() const {return _tree;}
+            inline const tree::cpu::vp_tree_t<M>& tree() const {return _tree;}
             
             /*! \brief Sets the vp-tree */    
-            inline tree::cpu::vp_tree& tree() {return _tree;}
+            inline tree::cpu::vp_tree_t<M>& tree() {return _tree;}
 
             /*! \brief Sets the v_list of dbscan */
-            inline std::shared_ptr<std::vector<std::pair<int,int>>>& v_list()
+            inline std::shared_ptr<std::vector<std::pair<int,size_t>>>& v_list()
                 { return _v_list;}
 
             /*! \brief Gets the v_list of dbscan */
-            inline const std::shared_ptr<std::vector<std::pair<int,int>>>& 
+            inline const std::shared_ptr<std::vector<std::pair<int,size_t>>>& 
                 v_list() const { return _v_list;}
 
             /*! \brief Sets the e_list of dbscan */
-            inline std::shared_ptr<std::vector<int>>& e_list() {return _e_list;}
+            inline std::shared_ptr<std::vector<point_id>>& e_list() {return _e_list;}
 
             /*! \brief Gets the e_list of dbscan */
-            inline const std::shared_ptr<std::vector<int>>& e_list() 
+            inline const std::shared_ptr<std::vector<point_id>>& e_list() 
                 const {return _e_list;}
 
         protected:
@@ -107,65 +110,74 @@ namespace cpu
                     std::vector<bool>& xa,
                     std::vector<bool>& fa) const;
 
-            tree::cpu::vp_tree _tree; /*!< \brief VP-tree for the knn search */
+            tree::cpu::vp_tree_t<M> _tree; /*!< \brief VP-tree for the knn search */
 
             /*! \brief vertex list as specified on reference paper 
              *
              * This is a list where the index represents the index of the
              * vertex on the data. The two values represents how many adjacent
              * points this vertex has within the epsilon distance and it's
-             * index on the adjacency list (_e_list);
+             * index on the adjacency list (_e_list). The index is 64 bits,
+             * the number of edges grows past 2^31 long before the number of
+             * points
              * */
-            std::shared_ptr<std::vector<std::pair<int,int>>> _v_list; 
+            std::shared_ptr<std::vector<std::pair<int,size_t>>> _v_list; 
 
             /*! \brief adjacency list as specified on reference paper 
              *
              * Contains the adjacency list of the graph
              * */
-            std::shared_ptr<std::vector<int>> _e_list;
+            std::shared_ptr<std::vector<point_id>> _e_list;
     };
+
+    /*! \brief dbscan of a metric function chosen at run time */
+    using dbscan = dbscan_t<metric::cpu::any_metric>;
 };
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-cluster::cpu::dbscan::dbscan() : 
+template <typename M>
+cluster::cpu::dbscan_t<M>::dbscan_t() : 
     cluster::dbscan(),
-    _v_list(new std::vector<std::pair<int,int>>()),
-    _e_list(new std::vector<int>())
+    _v_list(new std::vector<std::pair<int,size_t>>()),
+    _e_list(new std::vector<point_id>())
 {
     /* Nothing to do here */
 }
 
 ///////////////////////////////////////////////////////////////////////////////
  
-cluster::cpu::dbscan::dbscan(std::shared_ptr<const std::vector<float>> data, 
-        const float eps, const int min_pts, const int dim, 
-        metric::cpu::metric_f metric) : 
-    cluster::dbscan(data, eps, min_pts, dim), 
-    _tree(data, dim, metric),
-    _v_list(new std::vector<std::pair<int,int>>()),
-    _e_list(new std::vector<int>())
+template <typename M>
+cluster::cpu::dbscan_t<M>::dbscan_t(std::shared_ptr<const dataset> data, 
+        const float eps, const int min_pts, 
+        M metric) : 
+    cluster::dbscan(data, eps, min_pts), 
+    _tree(data, metric),
+    _v_list(new std::vector<std::pair<int,size_t>>()),
+    _e_list(new std::vector<point_id>())
 {
     this->create_graph();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-cluster::cpu::dbscan::dbscan(std::shared_ptr<const std::vector<float>> data, 
-        const float eps, const int min_pts, const int dim, 
-        const tree::cpu::vp_tree& tree) : 
-    cluster::dbscan(data, eps, min_pts, dim), 
+template <typename M>
+cluster::cpu::dbscan_t<M>::dbscan_t(std::shared_ptr<const dataset> data, 
+        const float eps, const int min_pts, 
+        const tree::cpu::vp_tree_t<M>& tree) : 
+    cluster::dbscan(data, eps, min_pts), 
     _tree(tree),
-    _v_list(new std::vector<std::pair<int,int>>()),
-    _e_list(new std::vector<int>())
+    _v_list(new std::vector<std::pair<int,size_t>>()),
+    _e_list(new std::vector<point_id>())
 {
     this->create_graph();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-cluster::cpu::dbscan::dbscan(const cluster::cpu::dbscan& other) :
+template <typename M>
+cluster::cpu::dbscan_t<M>::dbscan_t(const cluster::cpu::dbscan_t<M>& other) :
     cluster::dbscan(other),
     _tree(other.tree()),
     _v_list(other.v_list()),
@@ -176,35 +188,36 @@ cluster::cpu::dbscan::dbscan(const cluster::cpu::dbscan& other) :
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void cluster::cpu::dbscan::fit(std::shared_ptr<const std::vector<float>> 
-        data, int dim)
+template <typename M>
+inline void cluster::cpu::dbscan_t<M>::fit(std::shared_ptr<const dataset> data)
 {
     _data = data;
-    _dim = dim;
+    _dim = data->dim();
 
-    _tree.fit(data, dim);
+    _tree.fit(data, _tree.metric());
 
     this->create_graph();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void cluster::cpu::dbscan::create_graph()
+template <typename M>
+inline void cluster::cpu::dbscan_t<M>::create_graph()
 {
-    std::vector<int> ids;
+    std::vector<point_id> ids;
 
     _v_list->clear();
     _e_list->clear();
 
     std::cout << "creating graph" << std::endl;
 
-    for (int i=0; i < _data->size(); i+=_dim)
+    for (point_id i=0; i < _data->size(); i++)
     {
         _tree.knn(i, _eps, ids); // nearest neighbor
 
-        _v_list->push_back(std::make_pair<int,int>(ids.size(), _e_list->size()));
+        _v_list->push_back(std::make_pair((int)ids.size(), _e_list->size()));
 
-        for (int id : ids)
+        for (point_id id : ids)
             _e_list->push_back(id);
     }
 
@@ -213,7 +226,8 @@ inline void cluster::cpu::dbscan::create_graph()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void cluster::cpu::dbscan::predict(std::vector<int>& assignements) const
+template <typename M>
+inline void cluster::cpu::dbscan_t<M>::predict(std::vector<int>& assignements) const
 {
     int cluster_label = 0;
     std::vector<bool> visited(_v_list->size(), false);
@@ -235,7 +249,8 @@ inline void cluster::cpu::dbscan::predict(std::vector<int>& assignements) const
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void cluster::cpu::dbscan::breadth_first_search(int v, int label,
+template <typename M>
+inline void cluster::cpu::dbscan_t<M>::breadth_first_search(int v, int label,
         std::vector<bool>& visited, std::vector<int>& assignements) const
 {
     std::vector<bool> xa(_v_list->size(), 0);
@@ -260,11 +275,12 @@ inline void cluster::cpu::dbscan::breadth_first_search(int v, int label,
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void cluster::cpu::dbscan::breadth_first_search_kernel(int v,
+template <typename M>
+inline void cluster::cpu::dbscan_t<M>::breadth_first_search_kernel(int v,
         std::vector<bool>& xa,
         std::vector<bool>& fa) const 
 {
-    register int nid;
+    register point_id nid;
 
     if (fa[v])
     {
@@ -0,0 +1,194 @@
+/*============================================================================*/
+/*! \file alignment.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 19:05
+ *
+ *  \brief Superposition of every frame on a reference
+ *
+ *  This file contains the implementation of a preprocessing pass that
+ *  centers every frame of the data and rotates it in place onto a reference
+ *  frame, or onto the average structure refined over a few passes. The
+ *  euclidean distance between aligned frames is then close to their RMSD
+ *  after optimal superposition, times sqrt(n_atoms)
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ALIGNMENT_HPP
+#define ALIGNMENT_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "error.hpp"
+#include "dataset.hpp"
+#include "thread_pool.hpp"
+#include "rmsd.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief RMSD between two successive averages below which the refinement
+ * of the average structure stops */
+#define ALIGNMENT_TOLERANCE 1e-5
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace metric {
+namespace cpu
+{
+    /*! \brief Alignment of the frames of a dataset
+     *
+     * The first pass superposes every frame on one frame of the data. Each
+     * following pass superposes them on the average of the frames aligned
+     * by the previous one, until the average moves less than
+     * ALIGNMENT_TOLERANCE. The rotation of each frame is the optimal one,
+     * the one of Kabsch, found with QCP (see rmsd.hpp). Frames are split
+     * between n_threads() threads
+     * */
+    class alignment
+    {
+        public:
+            /*! \brief Constructs an alignment not done yet */
+            alignment() : _reference_inner(0.0), _n_frames(0), _n_passes(0), _seconds(0.0) {}
+
+            /*!
+             * \brief Aligns the frames of data in place
+             *
+             * \param n_passes largest number of passes, the first one on
+             * the frame reference, the next ones on the average structure
+             * \param reference index of the frame of the first pass
+             * */
+            inline void fit(dataset& data, int n_passes = 1, size_t reference = 0);
+
+            /*! \brief Get centered reference of the last pass */
+            inline const std::vector<float>& reference() const {return _reference;}
+            /*! \brief Get number of passes done */
+            inline int n_passes() const {return _n_passes;}
+            /*! \brief Get number of frames aligned per second, all passes */
+            inline double throughput() const {return _seconds > 0.0 ? _n_frames / _seconds : 0.0;}
+
+            /*! \brief Set number of threads aligning the frames. Default:
+             * 0, all the hardware threads */
+            static inline int& n_threads() {return _n_threads;}
+
+        protected:
+            /*! \brief Aligns the frames [begin, end) on _reference and
+             * sums them in sum */
+            inline void align(dataset& data, size_t begin, size_t end,
+                    std::vector<double>& sum) const;
+
+            std::vector<float> _reference; /*!< centered reference */
+            double _reference_inner;        /*!< inner product of _reference */
+
+            size_t _n_frames; /*!< frames aligned, all passes */
+            int _n_passes;    /*!< passes done */
+            double _seconds;  /*!< time spent aligning */
+
+            static int _n_threads; /*!< threads aligning the frames */
+    };
+};
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+int metric::cpu::alignment::_n_threads = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::alignment::fit(dataset& data, int n_passes, size_t reference)
+{
+    int n_atoms = data.dim() / 3;
+    int n_threads = _n_threads < 1 ? thread_pool::hardware_threads() : _n_threads;
+    size_t chunk;
+
+    ASSERT_FATAL_ERROR(data.dim() % 3 == 0, "Frames must have 3 coordinates per atom");
+    ASSERT_FATAL_ERROR(reference < data.size() || data.size() == 0, "Reference frame out of bounds");
+
+    _n_frames = 0;
+    _n_passes = 0;
+    _seconds = 0.0;
+    if(data.size() == 0 || n_passes < 1) return;
+
+    _reference.assign(data[reference], data[reference] + data.dim());
+    _reference_inner = metric::cpu::qcp_center(_reference.data(), n_atoms);
+
+    n_threads = (int)std::min((size_t)n_threads, data.size());
+    chunk = (data.size() + n_threads - 1) / n_threads;
+
+    thread_pool pool(n_threads);
+
+    while(_n_passes < n_passes) {
+        std::vector<std::vector<double>> sums(n_threads, std::vector<double>(data.dim(), 0.0));
+        std::vector<float> average(data.dim());
+        double moved = 0.0;
+
+        auto t0 = std::chrono::high_resolution_clock::now();
+
+        for(int t=0; t < n_threads; t++) {
+            size_t begin = t * chunk, end = std::min(begin + chunk, data.size());
+            std::vector<double>* sum = &sums[t];
+            pool.push([this, &data, begin, end, sum]() {
+                this->align(data, begin, end, *sum);
+            });
+        }
+        pool.wait();
+
+        auto t1 = std::chrono::high_resolution_clock::now();
+        _seconds += std::chrono::duration<double>(t1-t0).count();
+        _n_frames += data.size();
+        _n_passes++;
+
+        if(_n_passes == n_passes) break;
+
+        // Average structure, reference of the next pass
+        for(int d=0; d < data.dim(); d++) {
+            double s = 0.0;
+            for(int t=0; t < n_threads; t++) s += sums[t][d];
+            average[d] = s / data.size();
+            moved += (average[d] - _reference[d]) * (average[d] - _reference[d]);
+        }
+
+        if(std::sqrt(moved / n_atoms) < ALIGNMENT_TOLERANCE) break;
+
+        _reference.swap(average);
+        _reference_inner = metric::cpu::qcp_center(_reference.data(), n_atoms);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::alignment::align(dataset& data, size_t begin, size_t end,
+        std::vector<double>& sum) const
+{
+    int n_atoms = data.dim() / 3;
+
+    for(size_t i=begin; i < end; i++) {
+        float* frame = data[i];
+        double S[9], rot[9];
+        double inner = metric::cpu::qcp_center(frame, n_atoms);
+        double e0 = (inner + _reference_inner) * 0.5;
+
+        metric::cpu::qcp_correlation(_reference.data(), frame, n_atoms, S);
+        metric::cpu::qcp_rotation(S, metric::cpu::qcp_eigenvalue(S, e0), rot);
+
+        for(int a=0; a < n_atoms; a++) {
+            double x = frame[3*a], y = frame[3*a+1], z = frame[3*a+2];
+
+            for(int p=0; p < 3; p++) {
+                frame[3*a+p] = rot[3*p] * x + rot[3*p+1] * y + rot[3*p+2] * z;
+                sum[3*a+p] += frame[3*a+p];
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !ALIGNMENT_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
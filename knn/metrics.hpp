@@ -17,6 +17,20 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "metrics_simd.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Number of coordinates summed between two tests of the threshold
+ * of the bounded metrics */
+#define METRIC_BLOCK 512
+
+///////////////////////////////////////////////////////////////////////////////
+
 namespace metric {
 namespace cpu
 {
@@ -24,35 +38,198 @@ namespace cpu
      * \brief Definition of the distance function used for defining the metric space.
      *
      * You should write functions based on this declaration
-     * \param id1 index of an element in the data array
-     * \param id2 index of an element in the data array
-     * \param data data array
+     * \param a row of an element in the dataset
+     * \param b row of an element in the dataset
      * \param dim dimention of the data
-     * \return distance between element of index a and b
+     * \return distance between elements a and b
      * */
-    using metric_f = float (*)(int, int, const std::vector<float>&, int);
+    using metric_f = float (*)(const float*, const float*, int);
+
+    /*!
+     * \brief Definition of a distance function only exact below a bound
+     *
+     * Used when the distance is only compared with values up to bound, so
+     * the computation can stop as soon as the distance is known to be
+     * larger
+     * \param bound largest distance needed exactly
+     * \return distance between elements a and b if it's not larger than
+     * bound, any value larger than bound otherwise
+     * */
+    using bounded_metric_f = float (*)(const float*, const float*, int, float);
 
     /*!
      * \brief Implementation of the euclidean metric 
+     *
+     * Uses the squared distance kernel selected by simd
+     * */
+    inline float euclidean(const float* a, const float* b, int dim);
+
+    /*!
+     * \brief Euclidean metric abandoned once larger than bound
+     *
+     * The squared distance is summed by blocks of METRIC_BLOCK coordinates
+     * and compared with bound^2 after each block. Abandoned distances are
+     * INFINITY, without any square root. Distances not larger than bound
+     * are the ones of euclidean, to the bit
+     * */
+    inline float bounded_euclidean(const float* a, const float* b, int dim, float bound);
+
+    /*!
+     * \brief Squared euclidean distance, summed by blocks of METRIC_BLOCK
+     * coordinates, stopping after the first block where it's larger than
+     * bound2
      * */
-    inline float euclidean(int a, int b, const std::vector<float>& data, int dim);
+    inline float squared_euclidean(const float* a, const float* b, int dim, 
+            float bound2 = INFINITY);
+
+    /*!
+     * \brief Get bounded version of metric, NULL if it has none
+     * */
+    inline bounded_metric_f bounded(metric_f metric);
+
+    /*!
+     * \brief Euclidean metric as a functor
+     *
+     * The metrics the vp-tree and dbscan are templated on are functors
+     * with the same interface: the distance, the bounded distance (see
+     * bounded_metric_f) and fixed_dim, the only dimention supported or 0
+     * for any. Their calls are known at compile time and inlined in the
+     * traversals
+     * */
+    struct euclidean_t
+    {
+        static const int fixed_dim = 0; /*!< any dimention */
+
+        /*! \brief Distance between a and b */
+        inline float operator()(const float* a, const float* b, int dim) const
+            {return metric::cpu::euclidean(a, b, dim);}
+        /*! \brief Distance between a and b, exact up to bound */
+        inline float operator()(const float* a, const float* b, int dim, float bound) const
+            {return metric::cpu::bounded_euclidean(a, b, dim, bound);}
+    };
+
+    /*!
+     * \brief Euclidean metric for points of dimention N
+     *
+     * The loop over the coordinates has a constant trip count, so the
+     * compiler unrolls it. Meant for the small points left after a
+     * projection, where abandoning a distance wouldn't save anything
+     * */
+    template <int N>
+    struct fixed_euclidean_t
+    {
+        static const int fixed_dim = N; /*!< only dimention supported */
+
+        /*! \brief Distance between a and b, dim is N */
+        inline float operator()(const float* a, const float* b, int dim) const;
+        /*! \brief Distance between a and b, always exact */
+        inline float operator()(const float* a, const float* b, int dim, float bound) const
+            {return (*this)(a, b, dim);}
+    };
+
+    /*!
+     * \brief Metric chosen at run time, a metric_f and its bounded version
+     *
+     * Type erased functor used by the vp_tree and dbscan typedefs, so the
+     * metric is still a function given when running, at the price of a
+     * call through a pointer for each distance
+     * */
+    class any_metric
+    {
+        public:
+            static const int fixed_dim = 0; /*!< any dimention */
+
+            /*! \brief Wraps metric, and its bounded version if it has one */
+            any_metric(metric_f metric = metric::cpu::euclidean) :
+                _metric(metric), _bounded(metric::cpu::bounded(metric)) {}
+
+            /*! \brief Distance between a and b */
+            inline float operator()(const float* a, const float* b, int dim) const
+                {return _metric(a, b, dim);}
+            /*! \brief Distance between a and b, exact up to bound */
+            inline float operator()(const float* a, const float* b, int dim, float bound) const
+                {return _bounded ? _bounded(a, b, dim, bound) : _metric(a, b, dim);}
+
+            /*! \brief Get the metric function */
+            inline metric_f function() const {return _metric;}
+
+            /*! \brief Compares the metric functions */
+            inline bool operator==(const any_metric& other) const {return _metric == other._metric;}
+
+        protected:
+            metric_f _metric;          /*!< metric function */
+            bounded_metric_f _bounded; /*!< bounded version, may be NULL */
+    };
 };
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline float metric::cpu::euclidean(int a, int b, const std::vector<float>& data, int dim)
+inline float metric::cpu::euclidean(const float* a, const float* b, int dim)
+{
+    return std::sqrt(metric::cpu::squared_euclidean(a, b, dim));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline float metric::cpu::bounded_euclidean(const float* a, const float* b, int dim, float bound)
+{
+    // Margin of a few ulps, so a sum larger than bound2 has a square root
+    // larger than bound whatever the rounding
+    float bound2 = bound * bound * (1.0f + 4 * FLT_EPSILON);
+    float res;
+
+    if(bound < 0.0f) return INFINITY; // every distance is larger
+
+    res = metric::cpu::squared_euclidean(a, b, dim, bound2);
+
+    return res > bound2 ? INFINITY : std::sqrt(res);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline float metric::cpu::squared_euclidean(const float* a, const float* b, int dim, 
+        float bound2)
 {
     float res = 0.0f;
 
-    ASSERT_FATAL_ERROR((a+dim <= data.size()) && (b+dim <= data.size()), "Out of bounds");
+    for(int i=0; i < dim; i+=METRIC_BLOCK) {
+        res += metric::cpu::simd::squared_euclidean(a+i, b+i, std::min(METRIC_BLOCK, dim-i));
+        if(res > bound2) break;
+    }
 
-    for(int i=0; i < dim; i++)
-    {
-        res += (data[a+i] - data[b+i]) * (data[a+i] - data[b+i]);
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline metric::cpu::bounded_metric_f metric::cpu::bounded(metric_f metric)
+{
+    if(metric == metric::cpu::euclidean) return metric::cpu::bounded_euclidean;
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <int N>
+inline float metric::cpu::fixed_euclidean_t<N>::operator()(const float* a, const float* b, 
+        int dim) const
+{
+    // One accumulator per lane of 8, which the compiler keeps in a vector
+    float acc[8] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    float res = 0.0f;
+
+    for(int i=0; i + 8 <= N; i+=8) {
+        for(int l=0; l < 8; l++)
+            acc[l] += (a[i+l] - b[i+l]) * (a[i+l] - b[i+l]);
     }
+    for(int i=N/8*8; i < N; i++)
+        acc[i%8] += (a[i] - b[i]) * (a[i] - b[i]);
+
+    for(int l=0; l < 8; l++) res += acc[l];
 
-    return sqrt(res);
+    return std::sqrt(res);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
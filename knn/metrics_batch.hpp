@@ -0,0 +1,224 @@
+/*============================================================================*/
+/*! \file metrics_batch.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 17:30
+ *
+ *  \brief Distances from one point to many
+ *
+ *  This file contains the implementation of the distances from a query to a
+ *  set of points of a dataset, computed in a single pass over the points and
+ *  split between threads for large sets
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef METRICS_BATCH_HPP
+#define METRICS_BATCH_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "types.hpp"
+#include "dataset.hpp"
+#include "metrics.hpp"
+#include "thread_pool.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Smallest number of floats of the points given to each thread */
+#define METRIC_BATCH_MIN_PARALLEL (1 << 20)
+
+/*! \brief Number of points of the scans done chunk by chunk */
+#define METRIC_BATCH_CHUNK 4096
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace metric {
+namespace cpu
+{
+    /*! \brief Distances from one query to many points
+     *
+     * The points are read once, in order. For the euclidean metric the
+     * query is split in blocks of METRIC_BLOCK floats, each block staying in
+     * L1 while it's compared with the same block of every point; distances
+     * are the ones of euclidean, to the bit. Other metrics are called point
+     * by point. Sets of more than METRIC_BATCH_MIN_PARALLEL floats are split
+     * between n_threads() threads
+     * */
+    class batch
+    {
+        public:
+            /*! \brief Distances from query to the points ids[0..n) of data
+             *
+             * \param metric metric functor, see metric::cpu::euclidean_t
+             * \param query row of the query, not necessarily in data
+             * \param dist n distances, dist[j] is the one of point ids[j]
+             * \param n_threads largest number of threads of a large set, 0
+             * for n_threads()
+             * */
+            template <typename M>
+            static inline void distances(const M& metric, const dataset& data,
+                    const float* query, const point_id* ids, size_t n, float* dist,
+                    int n_threads = 0);
+
+            /*! \brief Distances from query to the points [first, first+n) of
+             * data, dist[j] is the one of point first+j */
+            template <typename M>
+            static inline void distances(const M& metric, const dataset& data,
+                    const float* query, size_t first, size_t n, float* dist,
+                    int n_threads = 0);
+
+            /*! \brief Set number of threads computing the distances of a
+             * large set. Default: 0, all the hardware threads */
+            static inline int& n_threads() {return _n_threads;}
+
+        protected:
+            /*! \brief Rows of the points of a list of ids */
+            struct id_rows
+            {
+                const dataset& data; /*!< points */
+                const point_id* ids; /*!< ids of the rows */
+
+                /*! \brief Get row j */
+                inline const float* operator()(size_t j) const {return data.row(ids[j]);}
+            };
+
+            /*! \brief Rows of a range of points */
+            struct range_rows
+            {
+                const dataset& data; /*!< points */
+                size_t first;        /*!< first point of the range */
+
+                /*! \brief Get row j */
+                inline const float* operator()(size_t j) const {return data.row(first + j);}
+            };
+
+            /*! \brief Splits the points [0, n) between the threads */
+            template <typename M, typename R>
+            static inline void run(const M& metric, int dim, const float* query,
+                    const R& rows, size_t n, float* dist, int n_threads);
+
+            /*! \brief Distances of the points [begin, end), any metric */
+            template <typename M, typename R>
+            static inline void kernel(const M& metric, int dim, const float* query,
+                    const R& rows, size_t begin, size_t end, float* dist);
+
+            /*! \brief Distances of the points [begin, end), euclidean metric */
+            template <typename R>
+            static inline void kernel(const euclidean_t& metric, int dim, const float* query,
+                    const R& rows, size_t begin, size_t end, float* dist);
+
+            /*! \brief Distances of the points [begin, end), metric chosen
+             * at run time */
+            template <typename R>
+            static inline void kernel(const any_metric& metric, int dim, const float* query,
+                    const R& rows, size_t begin, size_t end, float* dist);
+
+            static int _n_threads; /*!< threads of the large sets */
+    };
+};
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+int metric::cpu::batch::_n_threads = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename M>
+inline void metric::cpu::batch::distances(const M& metric, const dataset& data,
+        const float* query, const point_id* ids, size_t n, float* dist, int n_threads)
+{
+    batch::run(metric, data.dim(), query, id_rows{data, ids}, n, dist, n_threads);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename M>
+inline void metric::cpu::batch::distances(const M& metric, const dataset& data,
+        const float* query, size_t first, size_t n, float* dist, int n_threads)
+{
+    batch::run(metric, data.dim(), query, range_rows{data, first}, n, dist, n_threads);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename M, typename R>
+inline void metric::cpu::batch::run(const M& metric, int dim, const float* query,
+        const R& rows, size_t n, float* dist, int n_threads)
+{
+    std::vector<std::thread> threads;
+    size_t chunk;
+
+    if(n_threads < 1) n_threads = _n_threads < 1 ? thread_pool::hardware_threads() : _n_threads;
+
+    // Threads only for sets worth starting them
+    n_threads = (int)std::min((size_t)n_threads, n * dim / METRIC_BATCH_MIN_PARALLEL);
+    if(n_threads <= 1) {
+        batch::kernel(metric, dim, query, rows, 0, n, dist);
+        return;
+    }
+
+    chunk = (n + n_threads - 1) / n_threads;
+    for(size_t begin=chunk; begin < n; begin+=chunk) {
+        threads.push_back(std::thread([&, begin]() {
+            batch::kernel(metric, dim, query, rows, begin, std::min(begin + chunk, n), dist);
+        }));
+    }
+    batch::kernel(metric, dim, query, rows, 0, chunk, dist);
+
+    for(std::thread& t : threads) t.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename M, typename R>
+inline void metric::cpu::batch::kernel(const M& metric, int dim, const float* query,
+        const R& rows, size_t begin, size_t end, float* dist)
+{
+    for(size_t j=begin; j < end; j++)
+        dist[j] = metric(query, rows(j), dim);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename R>
+inline void metric::cpu::batch::kernel(const euclidean_t&, int dim, const float* query,
+        const R& rows, size_t begin, size_t end, float* dist)
+{
+    std::fill(dist + begin, dist + end, 0.0f);
+
+    // Same blocks, summed in the same order, as metric::cpu::squared_euclidean
+    for(int i=0; i < dim; i+=METRIC_BLOCK) {
+        int size = std::min(METRIC_BLOCK, dim-i);
+
+        for(size_t j=begin; j < end; j++)
+            dist[j] += metric::cpu::simd::squared_euclidean(query + i, rows(j) + i, size);
+    }
+
+    for(size_t j=begin; j < end; j++)
+        dist[j] = std::sqrt(dist[j]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename R>
+inline void metric::cpu::batch::kernel(const any_metric& metric, int dim, const float* query,
+        const R& rows, size_t begin, size_t end, float* dist)
+{
+    if(metric.function() == metric::cpu::euclidean)
+        batch::kernel(euclidean_t(), dim, query, rows, begin, end, dist);
+    else
+        batch::kernel<any_metric, R>(metric, dim, query, rows, begin, end, dist);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !METRICS_BATCH_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
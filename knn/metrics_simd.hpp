@@ -0,0 +1,293 @@
+/*============================================================================*/
+/*! \file metrics_simd.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 16:05
+ *
+ *  \brief Vectorized squared euclidean distance kernels
+ *
+ *  This file contains the implementation of the squared euclidean distance
+ *  for SSE2, AVX2+FMA and AVX-512, and the selection of the widest one the
+ *  processor supports, made once at startup
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef METRICS_SIMD_HPP
+#define METRICS_SIMD_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define METRICS_SIMD_X86
+#include <immintrin.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace metric {
+namespace cpu
+{
+    /*! \brief Signature of the squared distance kernels */
+    using squared_f = float (*)(const float*, const float*, int);
+
+    /*! \brief Squared euclidean distance, one float accumulator */
+    inline float squared_euclidean_scalar(const float* a, const float* b, int dim);
+
+#ifdef METRICS_SIMD_X86
+    /*! \brief Squared euclidean distance, 4 SSE2 accumulators */
+    __attribute__((target("sse2")))
+    inline float squared_euclidean_sse2(const float* a, const float* b, int dim);
+
+    /*! \brief Squared euclidean distance, 4 AVX2 accumulators and FMA */
+    __attribute__((target("avx2,fma")))
+    inline float squared_euclidean_avx2(const float* a, const float* b, int dim);
+
+    /*! \brief Squared euclidean distance, 4 AVX-512 accumulators, the end
+     * of the points read with a masked load */
+    __attribute__((target("avx512f")))
+    inline float squared_euclidean_avx512(const float* a, const float* b, int dim);
+#endif
+
+    /*! \brief Selection of the squared distance kernel
+     *
+     * The kernel is chosen when the program starts, from the instruction
+     * sets reported by CPUID, so metrics call it without any test. Each
+     * kernel reads exactly dim floats of each point, rows don't need to be
+     * padded
+     * */
+    class simd
+    {
+        public:
+            /*! \brief Instruction sets of the kernels, narrowest first */
+            enum isa_t {SCALAR, SSE2, AVX2, AVX512};
+
+            /*! \brief Squared euclidean distance with the selected kernel */
+            static inline float squared_euclidean(const float* a, const float* b, int dim)
+                {return _kernel(a, b, dim);}
+
+            /*! \brief Get instruction set of the selected kernel */
+            static inline isa_t isa() {return _isa;}
+
+            /*! \brief Widest instruction set supported by the processor */
+            static inline isa_t supported();
+
+            /*! \brief Selects the kernel of isa, for benchmarks and tests
+             *
+             * \return false if the processor doesn't support isa, the kernel
+             * is then unchanged
+             * */
+            static inline bool use(isa_t isa);
+
+            /*! \brief Get kernel of isa, NULL if not built */
+            static inline squared_f kernel(isa_t isa);
+
+            /*! \brief Get name of isa */
+            static inline std::string name(isa_t isa);
+
+        protected:
+            static isa_t _isa;       /*!< instruction set of the kernel */
+            static squared_f _kernel; /*!< selected kernel */
+    };
+};
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+metric::cpu::simd::isa_t metric::cpu::simd::_isa = metric::cpu::simd::supported();
+metric::cpu::squared_f metric::cpu::simd::_kernel = metric::cpu::simd::kernel(metric::cpu::simd::_isa);
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline float metric::cpu::squared_euclidean_scalar(const float* a, const float* b, int dim)
+{
+    float res = 0.0f;
+
+    for(int i=0; i < dim; i++)
+        res += (a[i] - b[i]) * (a[i] - b[i]);
+
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef METRICS_SIMD_X86
+
+__attribute__((target("sse2")))
+inline float metric::cpu::squared_euclidean_sse2(const float* a, const float* b, int dim)
+{
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+    float lanes[4], res;
+    int i = 0;
+
+    // Independent accumulators hide the latency of the additions
+    for(; i + 16 <= dim; i+=16) {
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a+i),    _mm_loadu_ps(b+i));
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a+i+4),  _mm_loadu_ps(b+i+4));
+        __m128 d2 = _mm_sub_ps(_mm_loadu_ps(a+i+8),  _mm_loadu_ps(b+i+8));
+        __m128 d3 = _mm_sub_ps(_mm_loadu_ps(a+i+12), _mm_loadu_ps(b+i+12));
+
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(d2, d2));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(d3, d3));
+    }
+    for(; i + 4 <= dim; i+=4) {
+        __m128 d = _mm_sub_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d, d));
+    }
+
+    acc0 = _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3));
+    _mm_storeu_ps(lanes, acc0);
+    res = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+    for(; i < dim; i++)
+        res += (a[i] - b[i]) * (a[i] - b[i]);
+
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2,fma")))
+inline float metric::cpu::squared_euclidean_avx2(const float* a, const float* b, int dim)
+{
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    __m128 sum;
+    float lanes[4], res;
+    int i = 0;
+
+    for(; i + 32 <= dim; i+=32) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a+i),    _mm256_loadu_ps(b+i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a+i+8),  _mm256_loadu_ps(b+i+8));
+        __m256 d2 = _mm256_sub_ps(_mm256_loadu_ps(a+i+16), _mm256_loadu_ps(b+i+16));
+        __m256 d3 = _mm256_sub_ps(_mm256_loadu_ps(a+i+24), _mm256_loadu_ps(b+i+24));
+
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+        acc2 = _mm256_fmadd_ps(d2, d2, acc2);
+        acc3 = _mm256_fmadd_ps(d3, d3, acc3);
+    }
+    for(; i + 8 <= dim; i+=8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i));
+        acc0 = _mm256_fmadd_ps(d, d, acc0);
+    }
+
+    acc0 = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+    sum = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    _mm_storeu_ps(lanes, sum);
+    res = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+    for(; i < dim; i++)
+        res += (a[i] - b[i]) * (a[i] - b[i]);
+
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx512f")))
+inline float metric::cpu::squared_euclidean_avx512(const float* a, const float* b, int dim)
+{
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+    float lanes[16], res = 0.0f;
+    int i = 0;
+
+    for(; i + 64 <= dim; i+=64) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a+i),    _mm512_loadu_ps(b+i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a+i+16), _mm512_loadu_ps(b+i+16));
+        __m512 d2 = _mm512_sub_ps(_mm512_loadu_ps(a+i+32), _mm512_loadu_ps(b+i+32));
+        __m512 d3 = _mm512_sub_ps(_mm512_loadu_ps(a+i+48), _mm512_loadu_ps(b+i+48));
+
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+        acc2 = _mm512_fmadd_ps(d2, d2, acc2);
+        acc3 = _mm512_fmadd_ps(d3, d3, acc3);
+    }
+    for(; i + 16 <= dim; i+=16) {
+        __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a+i), _mm512_loadu_ps(b+i));
+        acc0 = _mm512_fmadd_ps(d, d, acc0);
+    }
+    if(i < dim) {
+        // Masked lanes are read as 0, the floats after the points are not read
+        __mmask16 mask = (__mmask16)((1u << (dim - i)) - 1);
+        __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a+i), _mm512_maskz_loadu_ps(mask, b+i));
+        acc1 = _mm512_fmadd_ps(d, d, acc1);
+    }
+
+    acc0 = _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3));
+    _mm512_storeu_ps(lanes, acc0);
+    for(int l=0; l < 16; l++) res += lanes[l];
+
+    return res;
+}
+
+#endif /* METRICS_SIMD_X86 */
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline metric::cpu::simd::isa_t metric::cpu::simd::supported()
+{
+#ifdef METRICS_SIMD_X86
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx512f")) return AVX512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return AVX2;
+    if(__builtin_cpu_supports("sse2")) return SSE2;
+#endif
+
+    return SCALAR;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline bool metric::cpu::simd::use(isa_t isa)
+{
+    if(isa > simd::supported() || simd::kernel(isa) == NULL) return false;
+
+    _isa = isa;
+    _kernel = simd::kernel(isa);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline metric::cpu::squared_f metric::cpu::simd::kernel(isa_t isa)
+{
+    switch(isa)
+    {
+        case SCALAR: return metric::cpu::squared_euclidean_scalar;
+#ifdef METRICS_SIMD_X86
+        case SSE2: return metric::cpu::squared_euclidean_sse2;
+        case AVX2: return metric::cpu::squared_euclidean_avx2;
+        case AVX512: return metric::cpu::squared_euclidean_avx512;
+#endif
+        default: return NULL;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline std::string metric::cpu::simd::name(isa_t isa)
+{
+    switch(isa)
+    {
+        case SCALAR: return "scalar";
+        case SSE2: return "sse2";
+        case AVX2: return "avx2";
+        case AVX512: return "avx512";
+        default: return "unknown";
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !METRICS_SIMD_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
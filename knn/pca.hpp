@@ -0,0 +1,626 @@
+/*============================================================================*/
+/*! \file pca.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 20:10
+ *
+ *  \brief Principal component analysis of the frames
+ *
+ *  This file contains the implementation of a dimentionality reduction
+ *  stage: the covariance of the frames is accumulated in a single pass,
+ *  its leading eigenvectors are found by subspace iteration and the frames
+ *  are projected on the fewest of them explaining a given fraction of the
+ *  variance
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef PCA_HPP
+#define PCA_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "error.hpp"
+#include "dataset.hpp"
+#include "thread_pool.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Number of frames of each rank-k update of the covariance */
+#define PCA_BLOCK 64
+
+/*! \brief Size of the first subspace searched for the components */
+#define PCA_MIN_SUBSPACE 16
+
+/*! \brief Extra vectors of the subspace, improving the convergence of the
+ * last components kept */
+#define PCA_OVERSAMPLING 8
+
+/*! \brief Multiplications by the covariance of each subspace iteration */
+#define PCA_ITERATIONS 8
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace metric {
+namespace cpu
+{
+    /*! \brief Principal components of the frames of a dataset
+     *
+     * Frames are added range by range, in any order, so the covariance can
+     * be accumulated while the trajectories are read. Each range is
+     * processed in blocks of PCA_BLOCK frames: every thread owns rows of
+     * the upper triangle of the covariance, of the same area, and updates
+     * them with the whole block while they are in cache. Only the triangle
+     * is stored, row by row. Sums are taken
+     * relative to the first frame added, which keeps them accurate in
+     * double.
+     *
+     * solve() then finds the leading eigenvectors by subspace iteration on
+     * a subspace doubled until its first components explain the target
+     * fraction of the total variance, the trace of the covariance
+     * */
+    class pca
+    {
+        public:
+            /*! \brief Constructs an empty analysis */
+            pca() : _dim(0), _n_samples(0), _total_variance(0.0) {}
+
+            /*! \brief Accumulates the covariance of the frames [first,
+             * first+n_points) of data */
+            inline void add(const dataset& data, size_t first, size_t n_points);
+
+            /*!
+             * \brief Finds the components of the frames added
+             *
+             * \param target fraction of the variance the components must
+             * explain, in (0, 1]
+             * */
+            inline void solve(double target);
+
+            /*! \brief Adds every frame of data and solves */
+            inline void fit(const dataset& data, double target)
+                {this->add(data, 0, data.size()); this->solve(target);}
+
+            /*! \brief Projects the frames of data on the components
+             *
+             * \return dataset of n_components() coordinates per point
+             * */
+            inline dataset transform(const dataset& data) const;
+
+            /*! \brief Get number of components kept */
+            inline int n_components() const {return _variance.size();}
+            /*! \brief Get components, n_components() rows of dim() floats */
+            inline const std::vector<float>& components() const {return _components;}
+            /*! \brief Get variance along each component, decreasing */
+            inline const std::vector<double>& variance() const {return _variance;}
+            /*! \brief Get mean of the frames added */
+            inline const std::vector<float>& mean() const {return _mean;}
+            /*! \brief Get fraction of the variance explained by the components */
+            inline double explained() const;
+            /*! \brief Get dimention of the frames */
+            inline int dim() const {return _dim;}
+
+            /*! \brief Set number of threads of the accumulation, the
+             * subspace iteration and the projection. Default: 0, all the
+             * hardware threads */
+            static inline int& n_threads() {return _n_threads;}
+
+        protected:
+            /*! \brief Calls task(t, n_threads) on every thread t */
+            static inline void parallel(const std::function<void(int, int)>& task);
+
+            /*! \brief out = C q for the n_vectors vectors of q, dim() doubles
+             * each */
+            inline void multiply(const std::vector<double>& cov, const std::vector<double>& q,
+                    int n_vectors, std::vector<double>& out) const;
+
+            /*! \brief Index in _cross of the product of coordinates i and j,
+             * i <= j */
+            inline size_t packed(int i, int j) const
+                {return (size_t)i * _dim - (size_t)i * (i + 1) / 2 + j;}
+
+            /*! \brief Orthonormalizes the n_vectors vectors of q, dim()
+             * doubles each, with modified Gram-Schmidt done twice */
+            inline void orthonormalize(std::vector<double>& q, int n_vectors) const;
+
+            /*!
+             * \brief Eigen decomposition of a symmetric matrix
+             *
+             * Householder reduction to a tridiagonal matrix then implicit QL,
+             * the tred2 and tql2 routines of EISPACK
+             * \param a n x n matrix, destroyed
+             * \param values eigenvalues, decreasing
+             * \param vectors eigenvector of values[i] is row i, n x n
+             * */
+            static inline void eigen(std::vector<double>& a, int n,
+                    std::vector<double>& values, std::vector<double>& vectors);
+
+            int _dim;          /*!< dimention of the frames */
+            size_t _n_samples; /*!< frames added */
+
+            std::vector<double> _shift; /*!< first frame added */
+            std::vector<double> _sum;   /*!< sum of the frames minus _shift */
+            std::vector<double> _cross; /*!< upper triangle of the sum of their products, packed */
+
+            std::vector<float> _mean;       /*!< mean of the frames */
+            std::vector<float> _components; /*!< components, row by row */
+            std::vector<double> _variance;  /*!< variance along each component */
+            double _total_variance;         /*!< trace of the covariance */
+
+            static int _n_threads; /*!< threads of the analysis */
+    };
+};
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+int metric::cpu::pca::_n_threads = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::pca::add(const dataset& data, size_t first, size_t n_points)
+{
+    int dim = data.dim();
+
+    ASSERT_FATAL_ERROR(first + n_points <= data.size(), "Out of bounds");
+    ASSERT_FATAL_ERROR(_n_samples == 0 || _dim == dim, "Frames of different dimentions");
+
+    if(n_points == 0) return;
+
+    if(_n_samples == 0) {
+        _dim = dim;
+        _shift.assign(data[first], data[first] + dim);
+        _sum.assign(dim, 0.0);
+        _cross.assign((size_t)dim * (dim + 1) / 2, 0.0);
+    }
+
+    for(size_t i=first; i < first + n_points; i++)
+        for(int d=0; d < dim; d++) _sum[d] += data[i][d] - _shift[d];
+
+    pca::parallel([&](int t, int n_threads) {
+        // Rows of the upper triangle of the same area, row i has dim-i products
+        double area = 0.5 * dim * (dim + 1) / n_threads, before = 0.0;
+        int begin = dim, end = dim;
+
+        for(int i=0; i < dim; i++) {
+            if(begin == dim && before >= area * t) begin = i;
+            if(end == dim && before >= area * (t + 1) && t < n_threads - 1) end = i;
+            before += dim - i;
+        }
+
+        std::vector<double> y(PCA_BLOCK * (size_t)dim);
+
+        for(size_t b=first; b < first + n_points; b+=PCA_BLOCK) {
+            int size = std::min((size_t)PCA_BLOCK, first + n_points - b);
+
+            // Block relative to the first frame, only the columns of the rows owned
+            for(int f=0; f < size; f++)
+                for(int j=begin; j < dim; j++) y[(size_t)f * dim + j] = data[b+f][j] - _shift[j];
+
+            // Rank-k update of the rows, 4 frames per pass over a row
+            for(int i=begin; i < end; i++) {
+                // row[j] is the product of coordinates i and j, j >= i
+                double* row = &_cross[this->packed(i, 0)];
+                int f = 0;
+
+                for(; f + 4 <= size; f+=4) {
+                    const double* y0 = &y[(size_t)f * dim];
+                    const double* y1 = y0 + dim;
+                    const double* y2 = y1 + dim;
+                    const double* y3 = y2 + dim;
+                    double a0 = y0[i], a1 = y1[i], a2 = y2[i], a3 = y3[i];
+
+                    for(int j=i; j < dim; j++)
+                        row[j] += a0 * y0[j] + a1 * y1[j] + a2 * y2[j] + a3 * y3[j];
+                }
+                for(; f < size; f++) {
+                    const double* y0 = &y[(size_t)f * dim];
+                    double a0 = y0[i];
+
+                    for(int j=i; j < dim; j++) row[j] += a0 * y0[j];
+                }
+            }
+        }
+    });
+
+    _n_samples += n_points;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::pca::solve(double target)
+{
+    int dim = _dim, n_components = 1;
+    std::vector<double> cov((size_t)dim * dim);
+    std::vector<double> values, vectors, q;
+    std::mt19937 rand(0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    ASSERT_FATAL_ERROR(_n_samples > 0, "No frames added");
+    ASSERT_FATAL_ERROR(target > 0.0 && target <= 1.0, "Explained variance must be in (0, 1]");
+
+    // Covariance, from the sums relative to the first frame
+    _mean.resize(dim);
+    for(int i=0; i < dim; i++)
+        _mean[i] = _shift[i] + _sum[i] / _n_samples;
+
+    _total_variance = 0.0;
+    for(int i=0; i < dim; i++) {
+        for(int j=i; j < dim; j++) {
+            double c = (_cross[this->packed(i, j)] - _sum[i] * _sum[j] / _n_samples) / _n_samples;
+            cov[(size_t)i * dim + j] = cov[(size_t)j * dim + i] = c;
+        }
+        _total_variance += cov[(size_t)i * dim + i];
+    }
+
+    // The whole variance needs every component, no subspace is searched
+    int first_size = target >= 1.0 ? dim : std::min(PCA_MIN_SUBSPACE, dim);
+
+    for(int size=first_size; ; size=std::min(2 * size, dim)) {
+        int n_vectors = std::min(size + PCA_OVERSAMPLING, dim);
+
+        // Past half the dimention a decomposition of the covariance is cheaper
+        if(2 * n_vectors > dim) size = n_vectors = dim;
+        std::vector<double> cq, small;
+        double explained = 0.0;
+
+        if(n_vectors == dim) {
+            // Whole space, the covariance itself is decomposed. It is the
+            // last size searched, so eigen can destroy it
+            q.assign((size_t)dim * dim, 0.0);
+            for(int d=0; d < dim; d++) q[(size_t)d * dim + d] = 1.0;
+            small.swap(cov);
+        }
+        else {
+            // Subspace iteration from random vectors
+            small.resize((size_t)n_vectors * n_vectors);
+            q.resize((size_t)n_vectors * dim);
+            for(double& v : q) v = normal(rand);
+            this->orthonormalize(q, n_vectors);
+
+            for(int it=0; it < PCA_ITERATIONS; it++) {
+                this->multiply(cov, q, n_vectors, cq);
+                q.swap(cq);
+                this->orthonormalize(q, n_vectors);
+            }
+
+            // Rayleigh-Ritz on the subspace
+            this->multiply(cov, q, n_vectors, cq);
+            for(int a=0; a < n_vectors; a++) {
+                for(int b=0; b < n_vectors; b++) {
+                    double s = 0.0;
+                    for(int d=0; d < dim; d++) s += q[(size_t)a * dim + d] * cq[(size_t)b * dim + d];
+                    small[(size_t)a * n_vectors + b] = s;
+                }
+            }
+        }
+        pca::eigen(small, n_vectors, values, vectors);
+
+        // Fewest components explaining the target, at most size
+        for(n_components=1; n_components <= size; n_components++) {
+            explained += std::max(values[n_components-1], 0.0);
+            if(explained >= target * _total_variance) break;
+        }
+
+        if(n_components <= size || size == dim) {
+            n_components = std::min(n_components, size);
+
+            _variance.assign(values.begin(), values.begin() + n_components);
+            _components.assign((size_t)n_components * dim, 0.0f);
+            for(int c=0; c < n_components; c++) {
+                std::vector<double> comp(dim, 0.0);
+
+                for(int a=0; a < n_vectors; a++) {
+                    double w = vectors[(size_t)c * n_vectors + a];
+                    for(int d=0; d < dim; d++) comp[d] += w * q[(size_t)a * dim + d];
+                }
+                for(int d=0; d < dim; d++) _components[(size_t)c * dim + d] = comp[d];
+            }
+            return;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline dataset metric::cpu::pca::transform(const dataset& data) const
+{
+    int n_components = this->n_components();
+    dataset res(data.size(), std::max(n_components, 1));
+
+    ASSERT_FATAL_ERROR(n_components > 0, "Components not computed");
+    ASSERT_FATAL_ERROR(data.dim() == _dim, "Frames of different dimentions");
+
+    pca::parallel([&](int t, int n_threads) {
+        size_t chunk = (data.size() + n_threads - 1) / n_threads;
+        std::vector<float> centered(_dim);
+
+        for(size_t i=t*chunk; i < std::min((t+1)*chunk, data.size()); i++) {
+            for(int d=0; d < _dim; d++) centered[d] = data[i][d] - _mean[d];
+
+            for(int c=0; c < n_components; c++) {
+                // One accumulator per lane of 8, which the compiler keeps in a vector
+                const float* comp = &_components[(size_t)c * _dim];
+                float acc[8] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+                float s = 0.0f;
+
+                for(int d=0; d + 8 <= _dim; d+=8)
+                    for(int l=0; l < 8; l++) acc[l] += centered[d+l] * comp[d+l];
+                for(int d=_dim/8*8; d < _dim; d++) acc[d%8] += centered[d] * comp[d];
+                for(int l=0; l < 8; l++) s += acc[l];
+
+                res[i][c] = s;
+            }
+        }
+    });
+
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline double metric::cpu::pca::explained() const
+{
+    double s = 0.0;
+
+    for(double v : _variance) s += v;
+
+    return _total_variance > 0.0 ? s / _total_variance : 1.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::pca::parallel(const std::function<void(int, int)>& task)
+{
+    int n_threads = _n_threads < 1 ? thread_pool::hardware_threads() : _n_threads;
+
+    if(n_threads == 1) {
+        task(0, 1);
+        return;
+    }
+
+    thread_pool pool(n_threads);
+    for(int t=0; t < n_threads; t++)
+        pool.push([&task, t, n_threads]() {task(t, n_threads);});
+    pool.wait();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::pca::multiply(const std::vector<double>& cov, const std::vector<double>& q,
+        int n_vectors, std::vector<double>& out) const
+{
+    int dim = _dim;
+
+    out.resize((size_t)n_vectors * dim);
+
+    pca::parallel([&](int t, int n_threads) {
+        int chunk = (dim + n_threads - 1) / n_threads;
+
+        for(int i=t*chunk; i < std::min((t+1)*chunk, dim); i++) {
+            const double* row = &cov[(size_t)i * dim];
+
+            for(int v=0; v < n_vectors; v++) {
+                const double* x = &q[(size_t)v * dim];
+                double s = 0.0;
+                for(int d=0; d < dim; d++) s += row[d] * x[d];
+                out[(size_t)v * dim + i] = s;
+            }
+        }
+    });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::pca::orthonormalize(std::vector<double>& q, int n_vectors) const
+{
+    int dim = _dim;
+
+    for(int pass=0; pass < 2; pass++) {
+        for(int v=0; v < n_vectors; v++) {
+            double* x = &q[(size_t)v * dim];
+            double norm = 0.0;
+
+            for(int u=0; u < v; u++) {
+                const double* y = &q[(size_t)u * dim];
+                double s = 0.0;
+                for(int d=0; d < dim; d++) s += x[d] * y[d];
+                for(int d=0; d < dim; d++) x[d] -= s * y[d];
+            }
+
+            for(int d=0; d < dim; d++) norm += x[d] * x[d];
+            norm = std::sqrt(norm);
+
+            // A vector in the span of the previous ones is replaced by a
+            // basis vector, orthonormalized on the next pass
+            if(norm < 1e-300) {
+                std::fill(x, x + dim, 0.0);
+                x[v % dim] = 1.0;
+                continue;
+            }
+            for(int d=0; d < dim; d++) x[d] /= norm;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::pca::eigen(std::vector<double>& a, int n,
+        std::vector<double>& values, std::vector<double>& vectors)
+{
+    std::vector<double> d(n), e(n);
+    std::vector<int> order(n);
+    // v[i*n+k] is component k of vector i, the transpose of the storage of
+    // EISPACK, a is symmetric, so that every inner loop reads contiguous memory
+    double* v = a.data();
+    const double eps = std::pow(2.0, -52.0);
+
+    if(n == 0) return;
+
+    // Householder reduction to tridiagonal form
+    for(int j=0; j < n; j++) d[j] = v[(size_t)j * n + n-1];
+
+    for(int i=n-1; i > 0; i--) {
+        double scale = 0.0, h = 0.0;
+
+        for(int k=0; k < i; k++) scale += std::fabs(d[k]);
+
+        if(scale == 0.0) {
+            e[i] = d[i-1];
+            for(int j=0; j < i; j++) {
+                d[j] = v[(size_t)j * n + i-1];
+                v[(size_t)j * n + i] = 0.0;
+                v[(size_t)i * n + j] = 0.0;
+            }
+        }
+        else {
+            for(int k=0; k < i; k++) {
+                d[k] /= scale;
+                h += d[k] * d[k];
+            }
+
+            double f = d[i-1], g = std::sqrt(h);
+            if(f > 0) g = -g;
+            e[i] = scale * g;
+            h -= f * g;
+            d[i-1] = f - g;
+            for(int j=0; j < i; j++) e[j] = 0.0;
+
+            for(int j=0; j < i; j++) {
+                f = d[j];
+                v[(size_t)i * n + j] = f;
+                g = e[j] + v[(size_t)j * n + j] * f;
+                for(int k=j+1; k <= i-1; k++) {
+                    g += v[(size_t)j * n + k] * d[k];
+                    e[k] += v[(size_t)j * n + k] * f;
+                }
+                e[j] = g;
+            }
+
+            f = 0.0;
+            for(int j=0; j < i; j++) {
+                e[j] /= h;
+                f += e[j] * d[j];
+            }
+            double hh = f / (h + h);
+            for(int j=0; j < i; j++) e[j] -= hh * d[j];
+
+            for(int j=0; j < i; j++) {
+                f = d[j];
+                g = e[j];
+                for(int k=j; k <= i-1; k++)
+                    v[(size_t)j * n + k] -= f * e[k] + g * d[k];
+                d[j] = v[(size_t)j * n + i-1];
+                v[(size_t)j * n + i] = 0.0;
+            }
+        }
+        d[i] = h;
+    }
+
+    // Accumulation of the transformations
+    for(int i=0; i < n-1; i++) {
+        double h = d[i+1];
+
+        v[(size_t)i * n + n-1] = v[(size_t)i * n + i];
+        v[(size_t)i * n + i] = 1.0;
+
+        if(h != 0.0) {
+            for(int k=0; k <= i; k++) d[k] = v[(size_t)(i+1) * n + k] / h;
+            for(int j=0; j <= i; j++) {
+                double g = 0.0;
+                for(int k=0; k <= i; k++) g += v[(size_t)(i+1) * n + k] * v[(size_t)j * n + k];
+                for(int k=0; k <= i; k++) v[(size_t)j * n + k] -= g * d[k];
+            }
+        }
+        for(int k=0; k <= i; k++) v[(size_t)(i+1) * n + k] = 0.0;
+    }
+    for(int j=0; j < n; j++) {
+        d[j] = v[(size_t)j * n + n-1];
+        v[(size_t)j * n + n-1] = 0.0;
+    }
+    v[(size_t)(n-1) * n + n-1] = 1.0;
+    e[0] = 0.0;
+
+    // Implicit QL on the tridiagonal matrix
+    for(int i=1; i < n; i++) e[i-1] = e[i];
+    e[n-1] = 0.0;
+
+    double f = 0.0, tst1 = 0.0;
+    for(int l=0; l < n; l++) {
+        int m = l;
+
+        tst1 = std::max(tst1, std::fabs(d[l]) + std::fabs(e[l]));
+        while(m < n - 1 && std::fabs(e[m]) > eps * tst1) m++;
+
+        if(m > l) {
+            do {
+                double g = d[l];
+                double p = (d[l+1] - g) / (2.0 * e[l]);
+                double r = std::hypot(p, 1.0);
+                if(p < 0) r = -r;
+
+                d[l] = e[l] / (p + r);
+                d[l+1] = e[l] * (p + r);
+                double dl1 = d[l+1];
+                double h = g - d[l];
+                for(int i=l+2; i < n; i++) d[i] -= h;
+                f += h;
+
+                p = d[m];
+                double c = 1.0, c2 = c, c3 = c;
+                double el1 = e[l+1];
+                double s = 0.0, s2 = 0.0;
+
+                for(int i=m-1; i >= l; i--) {
+                    double* vi = &v[(size_t)i * n];
+                    double* vi1 = vi + n;
+
+                    c3 = c2; c2 = c; s2 = s;
+                    g = c * e[i];
+                    h = c * p;
+                    r = std::hypot(p, e[i]);
+                    e[i+1] = s * r;
+                    s = e[i] / r;
+                    c = p / r;
+                    p = c * d[i] - s * g;
+                    d[i+1] = h + s * (c * g + s * d[i]);
+
+                    for(int k=0; k < n; k++) {
+                        h = vi1[k];
+                        vi1[k] = s * vi[k] + c * h;
+                        vi[k] = c * vi[k] - s * h;
+                    }
+                }
+                p = -s * s2 * c3 * el1 * e[l] / dl1;
+                e[l] = s * p;
+                d[l] = c * p;
+            } while(std::fabs(e[l]) > eps * tst1);
+        }
+        d[l] += f;
+        e[l] = 0.0;
+    }
+
+    // Decreasing eigenvalues
+    for(int i=0; i < n; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&d](int x, int y) {return d[x] > d[y];});
+
+    values.resize(n);
+    vectors.resize((size_t)n * n);
+    for(int c=0; c < n; c++) {
+        values[c] = d[order[c]];
+        std::copy(v + (size_t)order[c] * n, v + (size_t)(order[c] + 1) * n, &vectors[(size_t)c * n]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !PCA_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,278 @@
+/*============================================================================*/
+/*! \file projection.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 21:20
+ *
+ *  \brief Sparse random projection of the frames
+ *
+ *  This file contains the implementation of a Johnson-Lindenstrauss
+ *  projection of the frames on a few hundred dimentions, with the sparse
+ *  matrices of Achlioptas generated from a seed, row by row, and never
+ *  stored
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef PROJECTION_HPP
+#define PROJECTION_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "error.hpp"
+#include "dataset.hpp"
+#include "thread_pool.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Number of frames projected with each row of the matrix generated */
+#define PROJECTION_BLOCK 256
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace metric {
+namespace cpu
+{
+    /*! \brief Sparse Johnson-Lindenstrauss projection
+     *
+     * A frame x of dim coordinates is mapped to sqrt(3/k) x R, with R a dim
+     * x k matrix of +1 and -1 with probability 1/6 each and 0 otherwise
+     * (Achlioptas, 2003). Row d of R is drawn from a generator seeded by
+     * seed and d, so the matrix is never stored: each thread draws the rows
+     * again for every block of PROJECTION_BLOCK frames, and only adds or
+     * subtracts coordinates, a third of the k outputs on average.
+     *
+     * Distortion: for n points and any beta > 0, if
+     *     k >= (4 + 2 beta) ln(n) / (eps^2/2 - eps^3/3)
+     * then with probability at least 1 - n^-beta every squared distance
+     * between two projected points is within a factor [1-eps, 1+eps] of
+     * the squared distance between the points, so every distance within
+     * [sqrt(1-eps), sqrt(1+eps)]. The bound doesn't depend on dim.
+     * */
+    class sparse_projection
+    {
+        public:
+            /*!
+             * \brief Constructs the projection
+             *
+             * \param dim dimention of the frames
+             * \param n_components dimention of the projected frames, k
+             * \param seed seed of the matrix, the same seed gives the same
+             * projection
+             * */
+            sparse_projection(int dim, int n_components, uint64_t seed = 0);
+
+            /*! \brief Projects the frames of data
+             *
+             * \return dataset of n_components() coordinates per point
+             * */
+            inline dataset transform(const dataset& data) const;
+
+            /*! \brief Projects the frames [first, first+n_points) of data in
+             * the same rows of res, which must have n_components()
+             * coordinates per point. Can be called on the ranges given to
+             * reader_xtc::frames_ready_f while the frames are read */
+            inline void transform(const dataset& data, size_t first, size_t n_points,
+                    dataset& res) const;
+
+            /*! \brief Get dimention of the frames */
+            inline int dim() const {return _dim;}
+            /*! \brief Get dimention of the projected frames */
+            inline int n_components() const {return _n_components;}
+
+            /*! \brief Smallest eps of the bound for n_points points projected
+             * on n_components dimentions, 1 if the bound says nothing */
+            static inline double distortion(size_t n_points, int n_components, double beta = 1.0);
+
+            /*! \brief Smallest n_components with a distortion of at most eps
+             * for n_points points */
+            static inline int min_components(size_t n_points, double eps, double beta = 1.0);
+
+            /*! \brief Set number of threads projecting the frames. Default:
+             * 0, all the hardware threads */
+            static inline int& n_threads() {return _n_threads;}
+
+        protected:
+            /*!
+             * \brief Draws row d of the matrix
+             *
+             * \param plus columns of the +1
+             * \param minus columns of the -1
+             * */
+            inline void row(int d, std::vector<int>& plus, std::vector<int>& minus) const;
+
+            /*! \brief Projects the frames [begin, end) of data */
+            inline void project(const dataset& data, size_t begin, size_t end,
+                    dataset& res) const;
+
+            int _dim;          /*!< dimention of the frames */
+            int _n_components; /*!< dimention of the projected frames */
+            uint64_t _seed;    /*!< seed of the matrix */
+
+            static int _n_threads; /*!< threads projecting the frames */
+    };
+};
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+int metric::cpu::sparse_projection::_n_threads = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline metric::cpu::sparse_projection::sparse_projection(int dim, int n_components, uint64_t seed) :
+    _dim(dim),
+    _n_components(n_components),
+    _seed(seed)
+{
+    ASSERT_FATAL_ERROR(dim > 0 && n_components > 0, "Dimentions must be positive");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline dataset metric::cpu::sparse_projection::transform(const dataset& data) const
+{
+    dataset res(data.size(), _n_components);
+
+    this->transform(data, 0, data.size(), res);
+
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::sparse_projection::transform(const dataset& data, size_t first,
+        size_t n_points, dataset& res) const
+{
+    int n_threads = _n_threads < 1 ? thread_pool::hardware_threads() : _n_threads;
+    size_t chunk;
+
+    ASSERT_FATAL_ERROR(data.dim() == _dim && res.dim() == _n_components, "Wrong dimentions");
+    ASSERT_FATAL_ERROR(first + n_points <= data.size() && first + n_points <= res.size(),
+            "Out of bounds");
+
+    // Whole blocks per thread, each thread draws every row once per block
+    n_threads = (int)std::max((size_t)1, std::min((size_t)n_threads, n_points / PROJECTION_BLOCK));
+    chunk = (n_points + n_threads - 1) / n_threads;
+
+    if(n_threads == 1) {
+        this->project(data, first, first + n_points, res);
+        return;
+    }
+
+    thread_pool pool(n_threads);
+    for(int t=0; t < n_threads; t++) {
+        size_t begin = first + t * chunk, end = std::min(begin + chunk, first + n_points);
+        pool.push([this, &data, begin, end, &res]() {
+            this->project(data, begin, end, res);
+        });
+    }
+    pool.wait();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline double metric::cpu::sparse_projection::distortion(size_t n_points, int n_components,
+        double beta)
+{
+    // eps^2/2 - eps^3/3 grows from 0 to 1/6 on [0, 1], found by bisection
+    double target = (4.0 + 2.0 * beta) * std::log((double)std::max(n_points, (size_t)2)) / n_components;
+    double low = 0.0, high = 1.0;
+
+    if(target >= 1.0 / 6.0) return 1.0;
+
+    for(int i=0; i < 60; i++) {
+        double eps = 0.5 * (low + high);
+        if(eps * eps / 2.0 - eps * eps * eps / 3.0 < target) low = eps;
+        else high = eps;
+    }
+
+    return high;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline int metric::cpu::sparse_projection::min_components(size_t n_points, double eps,
+        double beta)
+{
+    ASSERT_FATAL_ERROR(eps > 0.0 && eps < 1.0, "Distortion must be in (0, 1)");
+
+    return (int)std::ceil((4.0 + 2.0 * beta) * std::log((double)std::max(n_points, (size_t)2)) /
+            (eps * eps / 2.0 - eps * eps * eps / 3.0));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::sparse_projection::row(int d, std::vector<int>& plus,
+        std::vector<int>& minus) const
+{
+    // splitmix64 of the seed and the row, two draws of 32 bits per step
+    uint64_t state = _seed ^ (0x9e3779b97f4a7c15ULL * (uint64_t)(d + 1));
+
+    plus.clear();
+    minus.clear();
+
+    for(int c=0; c < _n_components; c+=2) {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+
+        for(int h=0; h < 2 && c + h < _n_components; h++) {
+            // Uniform in [0, 6) from 32 bits, 0 is +1, 1 is -1
+            uint32_t draw = (uint32_t)(((z >> (32 * h)) & 0xffffffffULL) * 6 >> 32);
+            if(draw == 0) plus.push_back(c + h);
+            else if(draw == 1) minus.push_back(c + h);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::sparse_projection::project(const dataset& data, size_t begin,
+        size_t end, dataset& res) const
+{
+    int k = _n_components;
+    float scale = std::sqrt(3.0f / k);
+    float column[PROJECTION_BLOCK];
+    std::vector<float> sums((size_t)k * PROJECTION_BLOCK);
+    std::vector<int> plus, minus;
+
+    for(size_t b=begin; b < end; b+=PROJECTION_BLOCK) {
+        int size = std::min((size_t)PROJECTION_BLOCK, end - b);
+
+        // Sums of the block are transposed, one output per row of
+        // PROJECTION_BLOCK floats, the frames missing in the last block are 0
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        std::fill(column, column + PROJECTION_BLOCK, 0.0f);
+
+        for(int d=0; d < _dim; d++) {
+            this->row(d, plus, minus);
+
+            for(int f=0; f < size; f++) column[f] = data[b+f][d];
+
+            for(int c : plus) {
+                float* s = &sums[(size_t)c * PROJECTION_BLOCK];
+                for(int f=0; f < PROJECTION_BLOCK; f++) s[f] += column[f];
+            }
+            for(int c : minus) {
+                float* s = &sums[(size_t)c * PROJECTION_BLOCK];
+                for(int f=0; f < PROJECTION_BLOCK; f++) s[f] -= column[f];
+            }
+        }
+
+        for(int f=0; f < size; f++)
+            for(int c=0; c < k; c++) res[b+f][c] = scale * sums[(size_t)c * PROJECTION_BLOCK + f];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !PROJECTION_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,236 @@
+/*============================================================================*/
+/*! \file quantized.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 13:10
+ *
+ *  \brief Quantized int16 coordinates and integer distance kernels
+ *
+ *  This file contains the implementation of a compact form of the data, 
+ *  replacing the floats, where each coordinate is stored as a 15 bits
+ *  integer, and of the euclidean metric computed on it with integer
+ *  arithmetic
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef QUANTIZED_HPP
+#define QUANTIZED_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "error.hpp"
+#include "dataset.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Largest quantized value
+ *
+ * Values are kept in [0, 2^15-1] so the difference of two values still fits
+ * in an int16 and the sum of two squared differences in an int32 */
+#define QUANTIZED_MAX 32767
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace metric {
+namespace cpu
+{
+    /*! \brief Quantization of data to int16
+     *
+     * Coordinate i of dimension d is stored as
+     *     q = round((x - offset[d]) * scale)
+     * with offset[d] the smallest value of dimension d and a single scale
+     * for all dimensions, chosen so the widest dimension spans [0, 2^15-1].
+     * Since the scale is the same in every dimension, distances between
+     * quantized points are the distances between the points times scale.
+     *
+     * Each coordinate is off by at most 0.5/scale, so each coordinate of
+     * a difference by at most 1/scale and the euclidean distance by at most
+     * sqrt(dim)/scale. For coordinates spanning 10 nm the quantization step
+     * 1/scale is 0.0003 nm, below the usual 0.001 nm precision of .xtc files.
+     *
+     * The quantized points are a dataset of their own, two int16 values in
+     * the bytes of each float. It replaces the floats in the vp-tree and
+     * dbscan, with quantized_t as metric, so the points take half the
+     * memory once the floats are freed
+     * */
+    class quantized_data
+    {
+        public:
+            /*! \brief Constructs an empty quantization */
+            quantized_data() : _dim(0), _scale(1.0f) {}
+
+            /*! \brief Constructs the quantization of data */
+            quantized_data(const dataset& data) {this->fit(data);}
+
+            /*! \brief Finds the offsets and the scale of data */
+            inline void fit(const dataset& data);
+
+            /*! \brief Quantizes the points of data
+             *
+             * \return dataset of packed_dim(dim()) floats per point, each
+             * holding two int16 values, the last one 0 for an odd dim()
+             * */
+            inline dataset transform(const dataset& data) const;
+
+            /*! \brief Get dimention of the points */
+            inline int dim() const {return _dim;}
+            /*! \brief Get scale of the quantization */
+            inline float scale() const {return _scale;}
+            /*! \brief Get offset of each dimension */
+            inline const std::vector<float>& offset() const {return _offset;}
+
+            /*! \brief Largest error of the euclidean distance of two points */
+            inline float max_error() const {return std::sqrt((float)_dim) / _scale;}
+
+            /*! \brief Number of floats holding the int16 values of a point
+             * of dimention dim */
+            static inline int packed_dim(int dim) {return (dim + 1) / 2;}
+
+        protected:
+            std::vector<float> _offset; /*!< offset of each dimension */
+
+            int _dim;     /*!< dimention of the points */
+            float _scale; /*!< scale of the quantization */
+    };
+
+    /*!
+     * \brief Squared euclidean distance of two quantized points
+     *
+     * Exact integer result, in quantized units
+     * */
+    inline int64_t squared_distance(const int16_t* a, const int16_t* b, int dim);
+
+    /*!
+     * \brief Euclidean metric of the points quantized by quantized_data
+     *
+     * Functor of the vp-tree and dbscan built on the dataset returned by
+     * quantized_data::transform. a and b are its rows and dim its packed
+     * dimention, distances are converted back to the units of the floats
+     * */
+    class quantized_t
+    {
+        public:
+            static const int fixed_dim = 0; /*!< any dimention */
+
+            /*! \brief Constructs the metric of a quantization of scale 1 */
+            quantized_t() : _scale(1.0f) {}
+
+            /*! \brief Constructs the metric of the points quantized by quantization */
+            quantized_t(const quantized_data& quantization) : _scale(quantization.scale()) {}
+
+            /*! \brief Distance between the quantized points of rows a and b */
+            inline float operator()(const float* a, const float* b, int dim) const;
+            /*! \brief Distance between the quantized points of rows a and b,
+             * always exact */
+            inline float operator()(const float* a, const float* b, int dim, float bound) const
+                {return (*this)(a, b, dim);}
+
+        protected:
+            float _scale; /*!< scale of the quantization */
+    };
+};
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::quantized_data::fit(const dataset& data)
+{
+    int dim = data.dim();
+    std::vector<float> top(dim, -INFINITY);
+    float range = 0.0f;
+
+    _dim = dim;
+    _offset.assign(dim, INFINITY);
+
+    // Range of each dimension
+    for(size_t i=0; i < data.size(); i++) {
+        for(int d=0; d < dim; d++) {
+            _offset[d] = std::min(_offset[d], data[i][d]);
+            top[d] = std::max(top[d], data[i][d]);
+        }
+    }
+    for(int d=0; d < dim && data.size(); d++)
+        range = std::max(range, top[d] - _offset[d]);
+
+    _scale = range > 0.0f ? QUANTIZED_MAX / range : 1.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline dataset metric::cpu::quantized_data::transform(const dataset& data) const
+{
+    dataset res(data.size(), quantized_data::packed_dim(_dim));
+
+    ASSERT_FATAL_ERROR(data.dim() == _dim, "Wrong dimentions");
+
+    // Rows of res are zeroed, the padding value of an odd dim stays 0
+    for(size_t i=0; i < data.size(); i++) {
+        int16_t* q = (int16_t*)res[i];
+
+        for(int d=0; d < _dim; d++) {
+            float v = std::round((data[i][d] - _offset[d]) * _scale);
+            q[d] = (int16_t)std::min(std::max(v, 0.0f), (float)QUANTIZED_MAX);
+        }
+    }
+
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline int64_t metric::cpu::squared_distance(const int16_t* a, const int16_t* b, int dim)
+{
+    int64_t res = 0;
+    int i = 0;
+
+#ifdef __SSE2__
+    // 8 differences per step. madd sums pairs of squares, at most
+    // 2*(2^15-1)^2 < 2^31, which are widened to 64 bits before adding
+    __m128i acc = _mm_setzero_si128(), zero = _mm_setzero_si128();
+
+    for(; i + 8 <= dim; i+=8) {
+        __m128i d = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)(a+i)),
+                _mm_loadu_si128((const __m128i*)(b+i)));
+        __m128i sq = _mm_madd_epi16(d, d);
+
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+    }
+
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    res = lanes[0] + lanes[1];
+#endif
+
+    for(; i < dim; i++) {
+        int32_t d = (int32_t)a[i] - b[i];
+        res += d * d;
+    }
+
+    return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline float metric::cpu::quantized_t::operator()(const float* a, const float* b, int dim) const
+{
+    // Both padding values are 0, the 2 dim values can be compared
+    return std::sqrt((double)metric::cpu::squared_distance((const int16_t*)a, 
+                (const int16_t*)b, 2 * dim)) / _scale;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !QUANTIZED_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,337 @@
+/*============================================================================*/
+/*! \file rmsd.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 18:10
+ *
+ *  \brief RMSD after optimal superposition, computed with QCP
+ *
+ *  This file contains the implementation of the root mean square deviation
+ *  of two frames after the rotation superposing them best, found with the
+ *  quaternion characteristic polynomial (QCP) method of Theobald (2005)
+ *  and Liu et al. (2010). The frames are centered once, so each distance
+ *  is a 3x3 correlation and a few Newton iterations
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef RMSD_HPP
+#define RMSD_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "error.hpp"
+#include "dataset.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Relative precision of the largest eigenvalue found by Newton */
+#define RMSD_EIGEN_PRECISION 1e-11
+
+/*! \brief Largest number of Newton iterations */
+#define RMSD_MAX_ITERATIONS 50
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace metric {
+namespace cpu
+{
+    /*! \brief Inner products of the frames of a dataset, centered in place
+     *
+     * Each point of the data is a frame of dim/3 atoms, (x, y, z) for each
+     * atom. The frames are moved to their centroid in the data itself, which
+     * the RMSD doesn't see, so only one inner product per frame is stored
+     * */
+    class rmsd_data
+    {
+        public:
+            /*! \brief Constructs empty data */
+            rmsd_data() : _source(NULL), _stride(1) {}
+
+            /*! \brief Centers the frames of data */
+            rmsd_data(dataset& data) {this->fit(data);}
+
+            /*! \brief Centers the frames of data in place and computes their
+             * inner products
+             *
+             * The rows of data are then the ones given to the metric, they
+             * must not move while it is used
+             * */
+            inline void fit(dataset& data);
+
+            /*! \brief Get inner product of each centered frame with itself */
+            inline const std::vector<double>& inner() const {return _inner;}
+            /*! \brief Get inner product of the frame of a row of the data */
+            inline double inner(const float* row) const {return _inner[this->index(row)];}
+
+            /*! \brief Get index of the frame of a row of the data */
+            inline size_t index(const float* row) const
+                {return (row - _source) / _stride;}
+
+        protected:
+            std::vector<double> _inner; /*!< G of each frame, sum of |x|^2 */
+
+            const float* _source; /*!< first row of the data */
+            size_t _stride;       /*!< floats between two rows of the data */
+    };
+
+    /*! \brief Moves the centroid of frame to the origin
+     *
+     * \return inner product of the centered frame with itself
+     * */
+    inline double qcp_center(float* frame, int n_atoms);
+
+    /*!
+     * \brief Correlation matrix of two centered frames
+     *
+     * S[3*p+q] is the sum over the atoms of coordinate p of a times
+     * coordinate q of b
+     * */
+    inline void qcp_correlation(const float* a, const float* b, int n_atoms, double S[9]);
+
+    /*!
+     * \brief Largest eigenvalue of the key matrix of a correlation matrix
+     *
+     * Found with Newton on the characteristic polynomial, from e0, the half
+     * sum of the inner products of the frames, which is an upper bound. 0 if
+     * e0 is below RMSD_EIGEN_PRECISION
+     * */
+    inline double qcp_eigenvalue(const double S[9], double e0);
+
+    /*!
+     * \brief Rotation superposing b on a, from their correlation matrix
+     *
+     * The quaternion is the eigenvector of the key matrix for lambda, a
+     * column of the adjugate of K - lambda I. a is then closest to rot * b,
+     * rot stored row by row. Identity if no column can be normalized
+     * */
+    inline void qcp_rotation(const double S[9], double lambda, double rot[9]);
+
+    /*!
+     * \brief RMSD of two centered frames after optimal superposition
+     *
+     * \param a centered frame of n_atoms atoms
+     * \param b centered frame of n_atoms atoms
+     * \param g_a inner product of a with itself
+     * \param g_b inner product of b with itself
+     * */
+    inline float qcp_rmsd(const float* a, const float* b, int n_atoms, double g_a, double g_b);
+
+    /*!
+     * \brief RMSD metric as a functor, see metric::cpu::euclidean_t
+     *
+     * a and b are rows of the data centered by the rmsd_data given. The
+     * distances never need to be abandoned, the bounded distance is always
+     * exact
+     * */
+    class rmsd_t
+    {
+        public:
+            static const int fixed_dim = 0; /*!< any number of atoms */
+
+            /*! \brief Constructs the metric of the frames of data */
+            rmsd_t(const rmsd_data& data) : _data(&data) {}
+
+            /*! \brief RMSD between the frames of rows a and b */
+            inline float operator()(const float* a, const float* b, int dim) const
+                {return metric::cpu::qcp_rmsd(a, b, dim / 3, _data->inner(a), _data->inner(b));}
+            /*! \brief RMSD between the frames of rows a and b, always exact */
+            inline float operator()(const float* a, const float* b, int dim, float) const
+                {return (*this)(a, b, dim);}
+
+        protected:
+            const rmsd_data* _data; /*!< inner products of the frames */
+    };
+};
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::rmsd_data::fit(dataset& data)
+{
+    ASSERT_FATAL_ERROR(data.dim() % 3 == 0, "Frames must have 3 coordinates per atom");
+
+    _source = data.data();
+    _stride = std::max(data.stride(), (size_t)1);
+    _inner.resize(data.size());
+
+    for(size_t i=0; i < data.size(); i++)
+        _inner[i] = metric::cpu::qcp_center(data[i], data.dim() / 3);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline double metric::cpu::qcp_center(float* frame, int n_atoms)
+{
+    double center[3] = {0.0, 0.0, 0.0}, inner = 0.0;
+
+    for(int a=0; a < n_atoms; a++)
+        for(int d=0; d < 3; d++) center[d] += frame[3*a+d];
+    for(int d=0; d < 3; d++) center[d] /= n_atoms;
+
+    for(int a=0; a < n_atoms; a++) {
+        for(int d=0; d < 3; d++) {
+            frame[3*a+d] -= center[d];
+            inner += (double)frame[3*a+d] * frame[3*a+d];
+        }
+    }
+
+    return inner;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::qcp_correlation(const float* a, const float* b, int n_atoms, double S[9])
+{
+    double Sxx = 0, Sxy = 0, Sxz = 0, Syx = 0, Syy = 0, Syz = 0, Szx = 0, Szy = 0, Szz = 0;
+
+    for(int i=0; i < n_atoms; i++) {
+        double xa = a[3*i], ya = a[3*i+1], za = a[3*i+2];
+        double xb = b[3*i], yb = b[3*i+1], zb = b[3*i+2];
+
+        Sxx += xa * xb; Sxy += xa * yb; Sxz += xa * zb;
+        Syx += ya * xb; Syy += ya * yb; Syz += ya * zb;
+        Szx += za * xb; Szy += za * yb; Szz += za * zb;
+    }
+
+    S[0] = Sxx; S[1] = Sxy; S[2] = Sxz;
+    S[3] = Syx; S[4] = Syy; S[5] = Syz;
+    S[6] = Szx; S[7] = Szy; S[8] = Szz;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline double metric::cpu::qcp_eigenvalue(const double S[9], double e0)
+{
+    double Sxx = S[0], Sxy = S[1], Sxz = S[2];
+    double Syx = S[3], Syy = S[4], Syz = S[5];
+    double Szx = S[6], Szy = S[7], Szz = S[8];
+    double lambda = e0;
+    double c0, c1, c2;
+
+    // Frames collapsed on their center, Newton would divide 0 by 0
+    if(e0 < RMSD_EIGEN_PRECISION) return 0.0;
+
+    // Coefficients of the characteristic polynomial of the 4x4 key matrix,
+    // lambda^4 + c2 lambda^2 + c1 lambda + c0
+    double Sxx2 = Sxx * Sxx, Syy2 = Syy * Syy, Szz2 = Szz * Szz;
+    double Sxy2 = Sxy * Sxy, Syz2 = Syz * Syz, Sxz2 = Sxz * Sxz;
+    double Syx2 = Syx * Syx, Szy2 = Szy * Szy, Szx2 = Szx * Szx;
+
+    double SyzSzymSyySzz2 = 2.0 * (Syz * Szy - Syy * Szz);
+    double Sxx2Syy2Szz2Syz2Szy2 = Syy2 + Szz2 - Sxx2 + Syz2 + Szy2;
+
+    c2 = -2.0 * (Sxx2 + Syy2 + Szz2 + Sxy2 + Syx2 + Sxz2 + Szx2 + Syz2 + Szy2);
+    c1 = 8.0 * (Sxx * Syz * Szy + Syy * Szx * Sxz + Szz * Sxy * Syx -
+            Sxx * Syy * Szz - Syz * Szx * Sxy - Szy * Syx * Sxz);
+
+    double SxzpSzx = Sxz + Szx, SyzpSzy = Syz + Szy, SxypSyx = Sxy + Syx;
+    double SyzmSzy = Syz - Szy, SxzmSzx = Sxz - Szx, SxymSyx = Sxy - Syx;
+    double SxxpSyy = Sxx + Syy, SxxmSyy = Sxx - Syy;
+    double Sxy2Sxz2Syx2Szx2 = Sxy2 + Sxz2 - Syx2 - Szx2;
+
+    c0 = Sxy2Sxz2Syx2Szx2 * Sxy2Sxz2Syx2Szx2
+        + (Sxx2Syy2Szz2Syz2Szy2 + SyzSzymSyySzz2) * (Sxx2Syy2Szz2Syz2Szy2 - SyzSzymSyySzz2)
+        + (-SxzpSzx * SyzmSzy + SxymSyx * (SxxmSyy - Szz)) * (-SxzmSzx * SyzpSzy + SxymSyx * (SxxmSyy + Szz))
+        + (-SxzpSzx * SyzpSzy - SxypSyx * (SxxpSyy - Szz)) * (-SxzmSzx * SyzmSzy - SxypSyx * (SxxpSyy + Szz))
+        + (SxypSyx * SyzpSzy + SxzpSzx * (SxxmSyy + Szz)) * (-SxymSyx * SyzmSzy + SxzpSzx * (SxxpSyy + Szz))
+        + (SxypSyx * SyzmSzy + SxzmSzx * (SxxmSyy - Szz)) * (-SxymSyx * SyzpSzy + SxzmSzx * (SxxpSyy - Szz));
+
+    // Newton from e0, an upper bound of the largest eigenvalue
+    for(int i=0; i < RMSD_MAX_ITERATIONS; i++) {
+        double previous = lambda;
+        double x2 = lambda * lambda;
+        double b = (x2 + c2) * lambda;
+        double a = b + c1;
+        double derivative = 2.0 * x2 * lambda + b + a;
+
+        // Double root, reached when the frames superpose exactly
+        if(derivative == 0.0) break;
+
+        lambda -= (a * lambda + c0) / derivative;
+        if(std::fabs(lambda - previous) < std::fabs(RMSD_EIGEN_PRECISION * lambda)) break;
+    }
+
+    return lambda;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void metric::cpu::qcp_rotation(const double S[9], double lambda, double rot[9])
+{
+    double Sxx = S[0], Sxy = S[1], Sxz = S[2];
+    double Syx = S[3], Syy = S[4], Syz = S[5];
+    double Szx = S[6], Szy = S[7], Szz = S[8];
+    double q[4] = {0.0, 0.0, 0.0, 0.0}, norm2 = 0.0;
+
+    // K - lambda I, symmetric
+    double m[4][4] = {
+        {Sxx + Syy + Szz - lambda, Syz - Szy, Szx - Sxz, Sxy - Syx},
+        {Syz - Szy, Sxx - Syy - Szz - lambda, Sxy + Syx, Szx + Sxz},
+        {Szx - Sxz, Sxy + Syx, Syy - Sxx - Szz - lambda, Syz + Szy},
+        {Sxy - Syx, Szx + Sxz, Syz + Szy, Szz - Sxx - Syy - lambda}};
+
+    // Columns of the adjugate are all along the eigenvector, the longest
+    // one is the most accurate
+    for(int c=0; c < 4; c++) {
+        double col[4], n2 = 0.0;
+
+        for(int r=0; r < 4; r++) {
+            // Cofactor of m[c][r], the minor without row c and column r
+            int rows[3], cols[3];
+            for(int i=0, k=0; i < 4; i++) if(i != c) rows[k++] = i;
+            for(int i=0, k=0; i < 4; i++) if(i != r) cols[k++] = i;
+
+            double minor =
+                m[rows[0]][cols[0]] * (m[rows[1]][cols[1]] * m[rows[2]][cols[2]] - m[rows[1]][cols[2]] * m[rows[2]][cols[1]]) -
+                m[rows[0]][cols[1]] * (m[rows[1]][cols[0]] * m[rows[2]][cols[2]] - m[rows[1]][cols[2]] * m[rows[2]][cols[0]]) +
+                m[rows[0]][cols[2]] * (m[rows[1]][cols[0]] * m[rows[2]][cols[1]] - m[rows[1]][cols[1]] * m[rows[2]][cols[0]]);
+
+            col[r] = (r + c) % 2 ? -minor : minor;
+            n2 += col[r] * col[r];
+        }
+
+        if(n2 > norm2) {
+            norm2 = n2;
+            std::copy(col, col + 4, q);
+        }
+    }
+
+    if(!(norm2 > 0.0) || !std::isfinite(norm2)) {
+        double identity[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+        std::copy(identity, identity + 9, rot);
+        return;
+    }
+
+    double norm = std::sqrt(norm2);
+    double w = q[0] / norm, x = q[1] / norm, y = q[2] / norm, z = q[3] / norm;
+
+    rot[0] = w*w + x*x - y*y - z*z; rot[1] = 2.0 * (x*y + w*z);       rot[2] = 2.0 * (x*z - w*y);
+    rot[3] = 2.0 * (x*y - w*z);       rot[4] = w*w - x*x + y*y - z*z; rot[5] = 2.0 * (y*z + w*x);
+    rot[6] = 2.0 * (x*z + w*y);       rot[7] = 2.0 * (y*z - w*x);       rot[8] = w*w - x*x - y*y + z*z;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline float metric::cpu::qcp_rmsd(const float* a, const float* b, int n_atoms,
+        double g_a, double g_b)
+{
+    double S[9];
+    double e0 = (g_a + g_b) * 0.5;
+
+    if(n_atoms <= 0) return 0.0f;
+
+    metric::cpu::qcp_correlation(a, b, n_atoms, S);
+
+    return std::sqrt(std::fabs(2.0 * (e0 - metric::cpu::qcp_eigenvalue(S, e0)) / n_atoms));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !RMSD_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
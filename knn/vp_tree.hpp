@@ -18,8 +18,11 @@
 
 #include <vector>
 #include <memory>
+#include <limits>
 
 #include "error.hpp"
+#include "types.hpp"
+#include "dataset.hpp"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -30,17 +33,17 @@ namespace tree
     {
         /*! \brief Creates a new node  
          *
-         * \param k index in data vector
+         * \param k index of the point in the data
          * \param d distance threshold if it's an internal node
          * \param lc index in tree vector of left child
          * \param rc index in tree vector or right child
          * \param par index in tree vector of the parent node (ROOT if node is
          * root)
          * */
-        vp_node_t(int k = 0, float d = 0.0f, int lc = 0, int rc = 0, int par = 0) : 
+        vp_node_t(point_id k = 0, float d = 0.0f, int lc = 0, int rc = 0, int par = 0) : 
             _key(k), _d(d), _lc(lc), _rc(rc), _par(par) {}
 
-        int _key; /*!< index in _data */
+        point_id _key; /*!< index of the point in _data */
         float _d; /*!< distance threshold */
         int _lc;  /*!< left child index */
         int _rc;  /*!< right child index */
@@ -59,24 +62,25 @@ namespace tree
         public:
             /*! \brief Constructs a new empty tree */
             vp_tree();
-            /*! \brief Constructs a tree with the new data and dimention */
-            vp_tree(std::shared_ptr<const std::vector<float>> data, int dim);
+            /*! \brief Constructs a tree with the new data, of the dimention
+             * of its points */
+            vp_tree(std::shared_ptr<const dataset> data);
             /*! \brief Constructs new tree based on existing tree */
             vp_tree(const vp_tree& other);
 
-            /*! \brief Constructs a new tree with the given data and dimention */
-            inline void fit(std::shared_ptr<const std::vector<float>> data, int dim);
+            /*! \brief Constructs a new tree with the given data */
+            inline void fit(std::shared_ptr<const dataset> data);
 
-            /*! \brief Get data vector */
-            inline const std::shared_ptr<const std::vector<float>>& data() const;
+            /*! \brief Get data */
+            inline const std::shared_ptr<const dataset>& data() const;
             /*! \brief Get dimention */
             inline int dim() const {return _dim;}
 
-            /*! \brief Set data vector 
+            /*! \brief Set data 
              *
              *  Use this function as your own responsability 
              *  */
-            inline std::shared_ptr<const std::vector<float>>& data();
+            inline std::shared_ptr<const dataset>& data();
             /*! \brief Set dimention  
              *
              * Use this function as your own responsability
@@ -84,7 +88,7 @@ namespace tree
             inline int& dim() {return _dim;}
 
         protected:
-            std::shared_ptr<const std::vector<float>> _data; /*!< data */
+            std::shared_ptr<const dataset> _data; /*!< data */
 
             int _dim; /*!< Dimention of data contained in data */
     };
@@ -100,13 +104,11 @@ inline tree::vp_tree::vp_tree() :
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline tree::vp_tree::vp_tree(std::shared_ptr<const std::vector<float>> data, 
-        int dim) :
-    _data(data),
-    _dim(dim)
+inline tree::vp_tree::vp_tree(std::shared_ptr<const dataset> data) :
+    _data(),
+    _dim()
 {
-    if((_data->size() % dim))
-        FATAL_ERROR("Data size and dimention not compatible");
+    this->fit(data);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -119,26 +121,26 @@ inline tree::vp_tree::vp_tree(const vp_tree& other)
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::vp_tree::fit(std::shared_ptr<const std::vector<float>> data,
-        int dim)
+inline void tree::vp_tree::fit(std::shared_ptr<const dataset> data)
 {
-    _data = data;
-    _dim = dim;
+    // The 2n - 1 nodes are indexed by an int and link their children by it
+    ASSERT_FATAL_ERROR(data->size() <= ((size_t)std::numeric_limits<int>::max() + 1) / 2, 
+            "Too many points for a vp-tree: " + std::to_string(data->size()));
 
-    if((_data->size() % dim))
-        FATAL_ERROR("Data size and dimention not compatible");
+    _data = data;
+    _dim = data->dim();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline const std::shared_ptr<const std::vector<float>>& tree::vp_tree::data() const
+inline const std::shared_ptr<const dataset>& tree::vp_tree::data() const
 {
     return _data;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline std::shared_ptr<const std::vector<float>>& tree::vp_tree::data()
+inline std::shared_ptr<const dataset>& tree::vp_tree::data()
 {
     return _data;
 }
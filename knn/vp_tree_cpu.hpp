@@ -18,12 +18,18 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <algorithm>
+#include <stack>
+#include <tuple>
+#include <memory>
+#include <map>
 
 #include "vp_tree.hpp"
 #include "metrics.hpp"
+#include "metrics_batch.hpp"
 #include "types.hpp"
 
 #include "time.hpp"
+#include "thread_pool.hpp"
 
 ///////////////////////////////////////////////////////////////////////////////
 /*! \brief Float comparision threshold 
@@ -36,33 +42,96 @@
 #define ROOT -2  /*!< Root descriptor */
 #define UNDEF -3 /*!< Undefined node descriptor */
 
+/*! \brief Smallest number of points of a subtree built as a task of its own,
+ * smaller subtrees are built by the task splitting their parent */
+#define VP_TREE_TASK_MIN 1024
+
 ///////////////////////////////////////////////////////////////////////////////
 
 namespace tree{
 namespace cpu
 {
-    /*! \brief Base class for creating vp-tree */
-    class vp_tree : public tree::vp_tree
+    /*! \brief Distances of every point to the root vantage point of a
+     * vp-tree, computed range by range while the data is being read
+     *
+     * The root vantage point is the first point, see vp_tree::select_vp.
+     * Ranges added before the first point are kept until it's added. Given
+     * to the vp-tree, the first level of the tree is split without
+     * computing any distance. Usage with reader_xtc:
+     *
+     *     root_distances root(metric);
+     *     data = reader_xtc::read_list(home, trajlist, n_atoms, 
+     *         [&](const dataset& d, size_t first, size_t count) {root.add(d, first, count);});
+     *     vp_tree tree(data, root);
+     *
+     * M is the metric functor, see metric::cpu::euclidean_t
+     * */
+    template <typename M>
+    class root_distances_t
+    {
+        public:
+            /*! \brief Constructs empty distances for the metric */
+            root_distances_t(M metric = M()) :
+                _metric(metric), _n_added(0), _root_added(false) {}
+
+            /*! \brief Computes the distances of the points [first, first+n_points)
+             *
+             * \param data whole data, sized for all the points even if only
+             * some of them are set
+             * */
+            inline void add(const dataset& data, size_t first, size_t n_points);
+
+            /*! \brief Get distance of each point to the first one */
+            inline const std::vector<float>& distances() const {return _dist;}
+            /*! \brief Get whether every point was added */
+            inline bool complete() const {return _root_added && _n_added == _dist.size();}
+            /*! \brief Get the metric */
+            inline const M& metric() const {return _metric;}
+
+        protected:
+            std::vector<float> _dist; /*!< distance of each point to the first one */
+
+            /*! \brief Ranges added before the first point, (first, n_points) */
+            std::vector<std::pair<size_t, size_t>> _pending;
+
+            M _metric;        /*!< metric of the vp-tree */
+            size_t _n_added;  /*!< number of points whose distance is computed */
+            bool _root_added; /*!< the first point was added */
+    };
+
+    /*! \brief Base class for creating vp-tree
+     *
+     * M is the metric functor, see metric::cpu::euclidean_t. Its distances
+     * are inlined in the traversals, vp_tree is the tree of a metric
+     * function chosen at run time
+     * */
+    template <typename M>
+    class vp_tree_t : public tree::vp_tree
     {
         public:
             /*! \brief Constructs a new empty tree */
-            vp_tree();
+            vp_tree_t();
 
             /*! \brief Constructs a new vp-tree
              *
              * \param data Data for creating vp-tree
-             * \param dim Dimention of the data
-             * \param metric metric function used in the vp-tree
+             * \param metric metric used in the vp-tree
              * */
-            vp_tree(std::shared_ptr<const std::vector<float>> data, int dim, 
-                    metric::cpu::metric_f metric = metric::cpu::euclidean);
+            vp_tree_t(std::shared_ptr<const dataset> data, M metric = M());
+
+            /*! \brief Constructs a new vp-tree using the distances to the
+             * root vantage point computed while data was read
+             *
+             * \param root distances of every point of data to the first one,
+             * the metric of the tree is the one of root
+             * */
+            vp_tree_t(std::shared_ptr<const dataset> data, const root_distances_t<M>& root);
 
             /*! \brief Copies another vp-tree to this object */
-            vp_tree(const vp_tree& other);
+            vp_tree_t(const vp_tree_t& other);
 
-            /*! \brief Constructs a new tree with the given data and dimention */
-            inline void fit(std::shared_ptr<const std::vector<float>> data, int dim, 
-                    metric::cpu::metric_f metric = metric::cpu::euclidean);
+            /*! \brief Constructs a new tree with the given data */
+            inline void fit(std::shared_ptr<const dataset> data, M metric = M());
 
             /*!
              * \brief Performs the knn search and returns all elements within the 
@@ -74,7 +143,7 @@ namespace cpu
              * \param delta maximum distance exclusive to search
              * \param id ids of elements in data closer to query than delta
              * */
-            inline void stack_knn(int query, float delta, std::vector<int>& id) const;
+            inline void stack_knn(point_id query, float delta, std::vector<point_id>& id) const;
             
             /*!
              * \brief Performs the knn search and returns all elements within the 
@@ -88,21 +157,21 @@ namespace cpu
              * \param delta maximum distance exclusive to search
              * \param id ids of elements in data closer to query than delta
              * */
-            inline void knn(int query, float delta, std::vector<int>& id) const;
+            inline void knn(point_id query, float delta, std::vector<point_id>& id) const;
 
             /*!
              * \brief Performs the knn search for each query and returns all
              * elements within the radius delta 
              *
-             * This function uses the knn(int, float, vector<int>) as base 
+             * This function uses the knn(point_id, float, vector<point_id>) as base 
              *
              * \param query indexes of each query in the data
              * \param delta maximum distance exclusive to search
              * \param ids ids of elements in data closer to query than delta.
              * For each query, there will be a vector of ids
              * */
-            inline void knn(const std::vector<int>& query, float delta, 
-                    std::vector<std::vector<int>>& ids) const;
+            inline void knn(const std::vector<point_id>& query, float delta, 
+                    std::vector<std::vector<point_id>>& ids) const;
 
             /*!
              * \brief Performs the knn search and returns k elements closest to the 
@@ -111,7 +180,7 @@ namespace cpu
              * This function uses a stack for speeding up the knn search and
              * it's not suitable for parellization in GPGPUs
              * */
-            inline void stack_knn(int query, int k, std::vector<int>& id) const;
+            inline void stack_knn(point_id query, int k, std::vector<point_id>& id) const;
 
             /*!
              * \brief Performs the knn search and returns k elements closest to the 
@@ -122,43 +191,43 @@ namespace cpu
              * slower due to the lack of a stack and the necessity of recomputing
              * distances
              * */
-            inline void knn(int query, int k, std::vector<int>& id) const;
+            inline void knn(point_id query, int k, std::vector<point_id>& id) const;
  
             /*!
              * \brief Performs the knn search for each query and returns
              * k elements closest to each query
              *
-             * This function uses the knn(int, int, vector<int>) as base 
+             * This function uses the knn(point_id, int, vector<point_id>) as base 
              *
              * \param queries indexes of each query in the data
              * \param k maximum distance exclusive to search
              * \param ids ids of elements in data closer to query than delta.
              * For each query, there will be a vector of ids
              * */
-            inline void knn(const std::vector<int>& queries, int k, 
-                    std::vector<std::vector<int>>& ids) const;
+            inline void knn(const std::vector<point_id>& queries, int k, 
+                    std::vector<std::vector<point_id>>& ids) const;
 
             /*!
              * \brief Same function as knn but using the brute force algorithm
              * */
-            inline void brute_knn(int query, float delta, std::vector<int>& id) const;
+            inline void brute_knn(point_id query, float delta, std::vector<point_id>& id) const;
             
             /*!
              * \brief Same function as knn but using the brute force algorithm
              * */
-            inline void brute_knn(int query, int k, std::vector<int>& id) const;
+            inline void brute_knn(point_id query, int k, std::vector<point_id>& id) const;
 
             /*!
              * \brief Finds the query in _data vector and returns its index in the 
              * tree 
              * */
-            inline int find(int query) const;
+            inline int find(point_id query) const;
 
             /*!
              * \brief Brute force algorithm to check wheater a query belongs to the
              * tree or not 
              * */
-            inline bool belongs(int query) const;
+            inline bool belongs(point_id query) const;
 
             /*!
              * \brief Get the tree
@@ -166,12 +235,16 @@ namespace cpu
             inline const std::shared_ptr<std::vector<tree::vp_node>>& t() const {return _tree;}
 
             /*!
-             * \brief Gets the metric function  
+             * \brief Gets the metric
              * */
-            inline const metric::cpu::metric_f& metric() const {return _metric;}
+            inline const M& metric() const {return _metric;}
+
+            /*! \brief Sets the metric */
+            inline M& metric() {return _metric;}
 
-            /*! \brief Sets the metric function */
-            inline metric::cpu::metric_f& metric() {return _metric;}
+            /*! \brief Set number of threads building the trees. Default: 0,
+             * all the hardware threads */
+            static inline int& n_threads() {return _n_threads;}
 
             /*! \brief prints the whole tree */
             void print_tree()
@@ -200,29 +273,76 @@ namespace cpu
 
         protected:
             /*!
-             * \brief Evaluates the distance between p and the set index_set setting each
-             * float in index_set
+             * \brief Distance between points a and b, only exact up to bound,
+             * see metric::cpu::bounded_metric_f
              * */
-            inline void dist2(int p, std::vector<ifloat>& index_set) const;
+            inline float distance(point_id a, point_id b, float bound) const
+                {return _metric(_data->row(a), _data->row(b), _dim, bound);}
+
+            /*! \brief Buffers of the distances of a subset, allocated once by
+             * each task building a subtree and reused by all its splits */
+            struct scratch
+            {
+                std::vector<point_id> ids; /*!< ids of the points */
+                std::vector<float> dist;   /*!< distances of the points */
+            };
 
             /*!
-             * \brief Select among elements in index_set the vantage point to split the Tree
+             * \brief Evaluates the distance between p and the set [first, last) setting each
+             * float in the set
+             *
+             * \param buffers buffers of the ids and distances, grown to the
+             * size of the set
+             * \param n_threads largest number of threads of a large set, 0
+             * for all the ones of metric::cpu::batch
              * */
-            inline int select_vp(const std::vector<ifloat>& index_set) const;
+            inline void dist2(point_id p, ifloat* first, ifloat* last, scratch& buffers,
+                    int n_threads = 0) const;
 
             /*!
-             * \brief Splits the index_set in two sub sets such that lc and rc are
-             * aproximately the same size
+             * \brief Select among elements in [first, last) the vantage point to split the Tree
+             * */
+            inline point_id select_vp(const ifloat* first, const ifloat* last) const;
+
+            /*!
+             * \brief Splits the set [first, last) in place in two sub sets
+             * [first, middle) and [middle, last) aproximately the same size
+             *
+             * Distances of the left set are smaller than the ones of the
+             * right set, and each set starts with its smallest distance, as
+             * if the set was sorted
              * \return The distance used for splitting the two subsets
              * */
-            inline float split(std::vector<ifloat>& index_set, 
-                    std::vector<ifloat>& lc, std::vector<ifloat>& rc) const;
+            inline float split(ifloat* first, ifloat* last, ifloat*& middle) const;
 
             /*!
              * \brief Constructs populating the _tree vector a vp_tree corresponding
              * to the data stored in the _data vector and specified in the index_set
+             *
+             * The subtree of a node of n points has 2n-1 nodes, stored after
+             * it: first the right subtree, then the left one. The id of every
+             * node is known once its parent is split, so subtrees are built
+             * independently, as tasks of a pool of n_threads() threads, into
+             * a tree identical to the one built by a single thread
+             *
+             * \param root_dist index_set already holds the distances to the
+             * root vantage point
              * */
-            inline int make_vp_tree(std::vector<ifloat>& index_set);
+            inline int make_vp_tree(std::vector<ifloat>& index_set, bool root_dist = false);
+
+            /*!
+             * \brief Builds the subtree of the points [first, last) of
+             * index_set in the nodes [node, node + 2 (last - first) - 1) of
+             * _tree, subsets are split in place
+             *
+             * \param parent id of the parent of node, ROOT for the root
+             * \param root_dist index_set already holds the distances to the
+             * vantage point of node
+             * \param pool pool the subtrees of at least VP_TREE_TASK_MIN
+             * points are pushed to, all of them are built here if null
+             * */
+            inline void make_subtree(ifloat* first, ifloat* last, int node, int parent,
+                    bool root_dist, thread_pool* pool);
 
             /*! \brief Tree structure is stored here 
              *
@@ -230,62 +350,103 @@ namespace cpu
              * in _data vector of super class */
             std::shared_ptr<std::vector<tree::vp_node>> _tree; 
 
-            /*! \brief Pointer to the metric function. 
+            /*! \brief Metric functor
              *
              * The metric function should return
-             * the squared distance between two elements in the data */
-            metric::cpu::metric_f _metric;
+             * the distance between two elements in the data */
+            M _metric;
+
+            static int _n_threads; /*!< threads building the trees */
     };
+
+    /*! \brief vp-tree of a metric function chosen at run time */
+    using vp_tree = vp_tree_t<metric::cpu::any_metric>;
+
+    /*! \brief Distances to the root of a vp_tree */
+    using root_distances = root_distances_t<metric::cpu::any_metric>;
 };
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline tree::cpu::vp_tree::vp_tree() :
+template <typename M>
+int tree::cpu::vp_tree_t<M>::_n_threads = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename M>
+inline tree::cpu::vp_tree_t<M>::vp_tree_t() :
     tree::vp_tree(),
     _tree(new std::vector<tree::vp_node>())
 {
     /* Nothing to be done here */
 }
 
-inline tree::cpu::vp_tree::vp_tree(std::shared_ptr<const std::vector<float>> data, 
-        int dim, metric::cpu::metric_f metric) :
-    tree::vp_tree(data, dim),
+template <typename M>
+inline tree::cpu::vp_tree_t<M>::vp_tree_t(std::shared_ptr<const dataset> data, 
+        M metric) :
+    tree::vp_tree(data),
     _metric(metric),
     _tree(new std::vector<tree::vp_node>())
 {
     std::vector<ifloat> index_set;
 
     // Populates index set with data
-    for(int i=0; i < _data->size(); i+=dim) 
-        index_set.push_back(ifloat(i, 0.0f));
+    index_set.resize(_data->size());
+    for(point_id i=0; i < _data->size(); i++) 
+        index_set[i] = ifloat(i, 0.0f);
 
     // Creates the tree 
     make_vp_tree(index_set);
 }
 
-inline tree::cpu::vp_tree::vp_tree(const tree::cpu::vp_tree& other) :
-    tree::vp_tree(other)
+template <typename M>
+inline tree::cpu::vp_tree_t<M>::vp_tree_t(std::shared_ptr<const dataset> data, 
+        const root_distances_t<M>& root) :
+    tree::vp_tree(data),
+    _metric(root.metric()),
+    _tree(new std::vector<tree::vp_node>())
 {
-    _metric = other.metric();
-    _tree = other.t();
+    std::vector<ifloat> index_set;
+
+    ASSERT_FATAL_ERROR(root.complete() && root.distances().size() == _data->size(), 
+            "Distances to the root missing");
+
+    // Populates index set with data and the distances to the root
+    index_set.resize(_data->size());
+    for(point_id i=0; i < _data->size(); i++) 
+        index_set[i] = ifloat(i, root.distances()[i]);
+
+    // Creates the tree 
+    make_vp_tree(index_set, true);
+}
+
+template <typename M>
+inline tree::cpu::vp_tree_t<M>::vp_tree_t(const tree::cpu::vp_tree_t<M>& other) :
+    tree::vp_tree(other),
+    _metric(other.metric()),
+    _tree(other.t())
+{
+    /* Nothing to be done here */
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::cpu::vp_tree::fit(std::shared_ptr<const std::vector<float>> data, 
-        int dim, metric::cpu::metric_f metric)
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::fit(std::shared_ptr<const dataset> data, 
+        M metric)
 {
     std::vector<ifloat> index_set;
 
     _metric = metric;
     _tree = std::make_shared<std::vector<tree::vp_node>>(std::vector<tree::vp_node>());
 
-    this->fit(data, dim);
+    tree::vp_tree::fit(data);
 
     // Populates index set with data
-    for(int i=0; i < _data->size(); i+=dim) 
-        index_set.push_back(ifloat(i, 0.0f));
+    index_set.resize(_data->size());
+    for(point_id i=0; i < _data->size(); i++) 
+        index_set[i] = ifloat(i, 0.0f);
 
     // Creates the tree 
     make_vp_tree(index_set);
@@ -293,12 +454,14 @@ inline void tree::cpu::vp_tree::fit(std::shared_ptr<const std::vector<float>> da
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::cpu::vp_tree::stack_knn(int query, float delta, std::vector<int>& id) const
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::stack_knn(point_id query, float delta, std::vector<point_id>& id) const
 {
     std::stack<int> stack; // recursion stack
     int cmp = 0; // root 
     //int cmp = _tree.size() - 1; // root
     float dist;
+    bool leaf;
 
     ASSERT_FATAL_ERROR(query < _data->size(), "Data doesn't contains the query");
 
@@ -308,9 +471,12 @@ inline void tree::cpu::vp_tree::stack_knn(int query, float delta, std::vector<in
     {
         cmp = stack.top(); stack.pop();
 
-        dist = _metric(query, (*_tree)[cmp]._key, *_data, _dim);
+        // Only the distances below the largest value compared are needed
+        leaf = (*_tree)[cmp]._lc == LEAF && (*_tree)[cmp]._rc == LEAF;
+        dist = this->distance(query, (*_tree)[cmp]._key, 
+                leaf ? delta : (*_tree)[cmp]._d + delta);
 
-        if((*_tree)[cmp]._lc == LEAF && (*_tree)[cmp]._rc == LEAF) {// if leaf
+        if(leaf) {// if leaf
             if(dist < delta)
                 id.push_back((*_tree)[cmp]._key);
         }
@@ -326,21 +492,25 @@ inline void tree::cpu::vp_tree::stack_knn(int query, float delta, std::vector<in
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::cpu::vp_tree::knn(int query, float delta, std::vector<int>& id) const
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::knn(point_id query, float delta, std::vector<point_id>& id) const
 {
     int iteration = 0;
     register bool go_down = true;
     register int node = 0, parent;
     float dist;
+    bool leaf;
 
     ASSERT_FATAL_ERROR(query < _data->size(), "Data doesn't contains the query");
 
     id.clear();
     do {
         if(go_down) {
-            dist = _metric(query, _tree->at(node)._key, *_data, _dim);
+            leaf = _tree->at(node)._lc == LEAF && _tree->at(node)._rc == LEAF;
+            dist = this->distance(query, _tree->at(node)._key, 
+                    leaf ? delta : _tree->at(node)._d + delta);
 
-            if(_tree->at(node)._lc == LEAF && _tree->at(node)._rc == LEAF) {// if leaf
+            if(leaf) {// if leaf
                 if(dist < delta) 
                     id.push_back(_tree->at(node)._key);
                 go_down = false;
@@ -357,7 +527,8 @@ inline void tree::cpu::vp_tree::knn(int query, float delta, std::vector<int>& id
             parent = _tree->at(node)._par;
 
             if(node == _tree->at(parent)._lc) {
-                dist = _metric(query, _tree->at(parent)._key, *_data, _dim);
+                dist = this->distance(query, _tree->at(parent)._key, 
+                        _tree->at(parent)._d - delta);
 
                 if(dist >= _tree->at(parent)._d - delta) {
                     go_down = true;
@@ -374,8 +545,9 @@ inline void tree::cpu::vp_tree::knn(int query, float delta, std::vector<int>& id
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::cpu::vp_tree::knn(const std::vector<int>& queries, float delta, 
-        std::vector<std::vector<int>>& ids) const
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::knn(const std::vector<point_id>& queries, float delta, 
+        std::vector<std::vector<point_id>>& ids) const
 {
     for (int i=0; i < queries.size(); i++)
         knn(queries[i], delta, ids[i]);
@@ -383,19 +555,21 @@ inline void tree::cpu::vp_tree::knn(const std::vector<int>& queries, float delta
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::cpu::vp_tree::stack_knn(int query, int k, std::vector<int>& id) const
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::stack_knn(point_id query, int k, std::vector<point_id>& id) const
 {
     std::vector<ifloat> heap;
     std::map<int, int> in_heap;
     std::stack<int> stack;
     float max_dist, dist;
     int cmp = 0;
+    bool leaf;
 
     ASSERT_FATAL_ERROR(query < _data->size(), "Data doesn't contains the query");
 
     for(int i=0; i < k; i++) {// Sets the heap with initial guesses
-        heap.push_back(ifloat(i*_dim, _metric(query, i*_dim, *_data, _dim)));
-        in_heap[i*_dim] = i*_dim;
+        heap.push_back(ifloat(i, _metric(_data->row(query), _data->row(i), _dim)));
+        in_heap[i] = i;
     }
 
     std::make_heap(heap.begin(), heap.end());
@@ -405,9 +579,11 @@ inline void tree::cpu::vp_tree::stack_knn(int query, int k, std::vector<int>& id
     {
         cmp = stack.top(); stack.pop();
 
-        dist = _metric(query, (*_tree)[cmp]._key, *_data, _dim);
+        leaf = (*_tree)[cmp]._lc == LEAF && (*_tree)[cmp]._rc == LEAF;
+        dist = this->distance(query, (*_tree)[cmp]._key, 
+                leaf ? max_dist : (*_tree)[cmp]._d + max_dist);
  
-        if((*_tree)[cmp]._lc == LEAF && (*_tree)[cmp]._rc == LEAF) {// if leaf
+        if(leaf) {// if leaf
             if(dist < max_dist && !in_heap.count((*_tree)[cmp]._key)) {
                 in_heap.erase(heap.front().key());
                 std::pop_heap(heap.begin(), heap.end()); heap.pop_back();
@@ -433,28 +609,32 @@ inline void tree::cpu::vp_tree::stack_knn(int query, int k, std::vector<int>& id
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::cpu::vp_tree::knn(int query, int k, std::vector<int>& id) const
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::knn(point_id query, int k, std::vector<point_id>& id) const
 {
     register bool go_down = true;
     register int node = 0, parent;
     std::vector<ifloat> heap;
     std::map<int, int> in_heap;
     float dist, max_dist;
+    bool leaf;
 
     ASSERT_FATAL_ERROR(query < _data->size(), "Data doesn't contains the query");
 
     for(int i=0; i < k; i++) {// Sets the heap with initial guesses
-        heap.push_back(ifloat(i*_dim, _metric(query, i*_dim, *_data, _dim)));
-        in_heap[i*_dim] = i*_dim;
+        heap.push_back(ifloat(i, _metric(_data->row(query), _data->row(i), _dim)));
+        in_heap[i] = i;
     }
 
     std::make_heap(heap.begin(), heap.end());
     max_dist = heap.front().val();
     do {
         if(go_down) {
-            dist = _metric(query, _tree->at(node)._key, *_data, _dim);
+            leaf = _tree->at(node)._lc == LEAF && _tree->at(node)._rc == LEAF;
+            dist = this->distance(query, _tree->at(node)._key, 
+                    leaf ? max_dist : _tree->at(node)._d + max_dist);
 
-            if(_tree->at(node)._lc == LEAF && _tree->at(node)._rc == LEAF) {// if leaf 
+            if(leaf) {// if leaf 
                 if(dist < max_dist && !in_heap.count((*_tree)[node]._key)) {
                     in_heap.erase(heap.front().key());
                     std::pop_heap(heap.begin(), heap.end()); heap.pop_back();
@@ -477,7 +657,8 @@ inline void tree::cpu::vp_tree::knn(int query, int k, std::vector<int>& id) cons
             parent = _tree->at(node)._par;
 
             if(node == _tree->at(parent)._lc) {
-                dist = _metric(query, _tree->at(parent)._key, *_data, _dim);
+                dist = this->distance(query, _tree->at(parent)._key, 
+                        _tree->at(parent)._d - max_dist);
 
                 if(dist >= _tree->at(parent)._d - max_dist) {
                     go_down = true;
@@ -498,8 +679,9 @@ inline void tree::cpu::vp_tree::knn(int query, int k, std::vector<int>& id) cons
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::cpu::vp_tree::knn(const std::vector<int>& queries, int k,
-        std::vector<std::vector<int>>& ids) const
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::knn(const std::vector<point_id>& queries, int k,
+        std::vector<std::vector<point_id>>& ids) const
 {
     for (int i=0; i < queries.size(); i++)
         knn(queries[i], k, ids[i]);
@@ -507,45 +689,59 @@ inline void tree::cpu::vp_tree::knn(const std::vector<int>& queries, int k,
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::cpu::vp_tree::brute_knn(int query, float delta, std::vector<int>& id) const
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::brute_knn(point_id query, float delta, std::vector<point_id>& id) const
 {
-    float dist;
+    std::vector<float> dist(std::min((size_t)METRIC_BATCH_CHUNK, _data->size()));
  
     ASSERT_FATAL_ERROR(query < _data->size(), "Data doesn't contains the query");
 
     id.clear();
-    for(int i=0; i < _data->size(); i+=_dim) {
-        dist = _metric(query, i, *_data, _dim);
+    for(size_t first=0; first < _data->size(); first+=METRIC_BATCH_CHUNK) {
+        size_t n = std::min((size_t)METRIC_BATCH_CHUNK, _data->size() - first);
+
+        metric::cpu::batch::distances(_metric, *_data, _data->row(query), first, n, dist.data());
 
-        if(dist < delta) 
-            id.push_back(i);
+        for(size_t j=0; j < n; j++) {
+            if(dist[j] < delta) 
+                id.push_back(first + j);
+        }
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::cpu::vp_tree::brute_knn(int query, int k, std::vector<int>& id) const
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::brute_knn(point_id query, int k, std::vector<point_id>& id) const
 {
-    float dist, max_dist;
+    std::vector<float> dist(std::min((size_t)METRIC_BATCH_CHUNK, _data->size()));
+    float max_dist = INFINITY;
     std::vector<ifloat> heap;
 
     ASSERT_FATAL_ERROR(query < _data->size(), "Data doesn't contains the query");
 
-    for(int i=0; i < k; i++)
-        heap.push_back(ifloat(i*_dim, _metric(query, i*_dim, *_data, _dim)));
-
     id.clear();
-    std::make_heap(heap.begin(), heap.end());
-    max_dist = heap.front().val();
+    for(size_t first=0; first < _data->size(); first+=METRIC_BATCH_CHUNK) {
+        size_t n = std::min((size_t)METRIC_BATCH_CHUNK, _data->size() - first);
 
-    for(int i=k*_dim; i < _data->size(); i+=_dim) {
-        dist = _metric(query, i, *_data, _dim);
+        metric::cpu::batch::distances(_metric, *_data, _data->row(query), first, n, dist.data());
 
-        if(dist < max_dist) {
-            std::pop_heap(heap.begin(), heap.end()); heap.pop_back();
-            heap.push_back(ifloat(i, dist));
-            std::push_heap(heap.begin(), heap.end());
-            max_dist = heap.front().val();
+        for(size_t j=0; j < n; j++) {
+            point_id i = first + j;
+
+            if(i < k) { // The first k points are the initial guesses
+                heap.push_back(ifloat(i, dist[j]));
+                if(i == k-1) {
+                    std::make_heap(heap.begin(), heap.end());
+                    max_dist = heap.front().val();
+                }
+            }
+            else if(dist[j] < max_dist) {
+                std::pop_heap(heap.begin(), heap.end()); heap.pop_back();
+                heap.push_back(ifloat(i, dist[j]));
+                std::push_heap(heap.begin(), heap.end());
+                max_dist = heap.front().val();
+            }
         }
     }
 
@@ -555,7 +751,8 @@ inline void tree::cpu::vp_tree::brute_knn(int query, int k, std::vector<int>& id
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline int tree::cpu::vp_tree::find(int query) const
+template <typename M>
+inline int tree::cpu::vp_tree_t<M>::find(point_id query) const
 {
     //int cmp = _tree.size() - 1;
     int cmp = 0;
@@ -569,7 +766,7 @@ inline int tree::cpu::vp_tree::find(int query) const
             FATAL_ERROR("Query not found ! :`(");
         }
 
-        if(_metric((*_tree)[cmp]._key, query, *_data, _dim) < (*_tree)[cmp]._d)
+        if(_metric(_data->row((*_tree)[cmp]._key), _data->row(query), _dim) < (*_tree)[cmp]._d)
             cmp = (*_tree)[cmp]._lc;
         else
             cmp = (*_tree)[cmp]._rc;
@@ -580,7 +777,8 @@ inline int tree::cpu::vp_tree::find(int query) const
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline bool tree::cpu::vp_tree::belongs(int query) const
+template <typename M>
+inline bool tree::cpu::vp_tree_t<M>::belongs(point_id query) const
 {
     ASSERT_FATAL_ERROR(query < _data->size(), "Data doesn't contains the query");
 
@@ -599,33 +797,47 @@ inline bool tree::cpu::vp_tree::belongs(int query) const
 /*!
  * Basic implementation still. Don't see the point for a more complicated code 
  * */
-inline int tree::cpu::vp_tree::select_vp(const std::vector<ifloat>& index_set) const
+template <typename M>
+inline point_id tree::cpu::vp_tree_t<M>::select_vp(const ifloat* first, const ifloat*) const
 {
-    return index_set.front().key();
+    return first->key();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline float tree::cpu::vp_tree::split(std::vector<ifloat>& index_set, 
-        std::vector<ifloat>& l_set, std::vector<ifloat>& r_set) const
+template <typename M>
+inline float tree::cpu::vp_tree_t<M>::split(ifloat* first, ifloat* last, ifloat*& middle) const
 {
-    int middle = index_set.size() / 2;
+    ifloat *next, *run;
+    float prev;
 
-    std::sort(index_set.begin(), index_set.end());
-    
-    for(int i=middle+1; i < index_set.size(); i++) {
-        if(std::abs(index_set[i].val() - index_set[i-1].val()) > EPSILON) {
-            //std::cout << index_set[i-1].val() << " " << index_set[i].val() << std::endl;
-            middle = i;
+    middle = first + (last - first) / 2;
+
+    std::nth_element(first, middle, last);
+
+    // The middle moves right past the distances closer than EPSILON to the
+    // previous one in sorted order. Each step brings in front of the right
+    // set the distances within EPSILON of the largest one already passed
+    prev = middle->val();
+    for(next = middle + 1; next < last; next = run) {
+        run = std::partition(next, last, 
+                [prev](const ifloat& x) {return !(std::abs(x.val() - prev) > EPSILON);});
+
+        if(run == next) {
+            std::iter_swap(next, std::min_element(next, last));
+            middle = next;
             break;
         }
+
+        std::iter_swap(run-1, std::max_element(next, run));
+        prev = (run-1)->val();
     }
 
-    l_set.clear(); r_set.clear();
-    l_set.assign(index_set.begin(), index_set.begin()+middle);
-    r_set.assign(index_set.begin()+middle, index_set.end());
+    // The right set already starts with its smallest distance, the left one
+    // starts with its own, the vantage point unless some point is repeated
+    std::iter_swap(first, std::min_element(first, middle));
 
-    return index_set[middle].val();
+    return middle->val();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -652,63 +864,134 @@ inline float tree::cpu::vp_tree::split(std::vector<ifloat>& index_set,
     return _tree.size()-1;
 }*/
 
-inline int tree::cpu::vp_tree::make_vp_tree(std::vector<ifloat>& index_set)
+template <typename M>
+inline int tree::cpu::vp_tree_t<M>::make_vp_tree(std::vector<ifloat>& index_set, bool root_dist)
 {
-    std::vector<ifloat> l_set, r_set;
-    std::stack<std::pair<std::vector<ifloat>, int>> stack;
-    std::vector<ifloat>& set_aux = index_set;
-    int p = 0, parent;
-    float mu = 0.0f;
+    int n_threads = _n_threads < 1 ? thread_pool::hardware_threads() : _n_threads;
 
-    p = this->select_vp(set_aux);
+    ASSERT_FATAL_ERROR(M::fixed_dim == 0 || M::fixed_dim == _dim, 
+            "Metric of dimention " + std::to_string(M::fixed_dim) + " given points of dimention " + 
+            std::to_string(_dim));
 
-    if(set_aux.size() <= 1)
-        (*_tree).push_back(tree::vp_node(p, 0, LEAF, LEAF, ROOT));
-    else {
-        this->dist2(p, set_aux);
-        mu = this->split(set_aux, l_set, r_set);
+    (*_tree).clear();
+    if(index_set.empty()) return 0;
 
-        stack.push(std::pair<std::vector<ifloat>, int>(l_set, (*_tree).size()));
-        stack.push(std::pair<std::vector<ifloat>, int>(r_set, (*_tree).size()));
+    (*_tree).resize(2 * index_set.size() - 1, tree::vp_node(0, 0, UNDEF, UNDEF, UNDEF));
 
-        (*_tree).push_back(tree::vp_node(p, mu, UNDEF, UNDEF, ROOT));
+    if(n_threads == 1 || index_set.size() < VP_TREE_TASK_MIN)
+        this->make_subtree(index_set.data(), index_set.data() + index_set.size(), 0, ROOT,
+                root_dist, nullptr);
+    else {
+        thread_pool pool(n_threads);
+        this->make_subtree(index_set.data(), index_set.data() + index_set.size(), 0, ROOT,
+                root_dist, &pool);
+        pool.wait();
     }
 
-    while(!stack.empty())
+    return 0; // root
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::make_subtree(ifloat* first, ifloat* last, 
+        int node, int parent, bool root_dist, thread_pool* pool)
+{
+    std::stack<std::tuple<ifloat*, ifloat*, int, int>> stack;
+    int n_threads = _n_threads < 1 ? thread_pool::hardware_threads() : _n_threads;
+    scratch buffers;
+    ifloat* middle;
+    point_id p = 0;
+    float mu = 0.0f;
+
+    buffers.ids.reserve(last - first);
+    buffers.dist.reserve(last - first);
+
+    while(true)
     {
-        set_aux = stack.top().first;
-        parent  = stack.top().second;
+        p = this->select_vp(first, last);
+
+        if(last - first == 1)
+            (*_tree)[node] = tree::vp_node(p, 0, LEAF, LEAF, parent);
+        else {
+            // Threads of the distances in proportion to the points, the top
+            // levels have less subtrees than threads
+            if(!root_dist) 
+                this->dist2(p, first, last, buffers,
+                        std::max((size_t)1, n_threads * (size_t)(last - first) / _data->size()));
+            root_dist = false;
+
+            mu = this->split(first, last, middle);
+
+            int rc = node + 1, lc = node + 2 * (last - middle);
+            (*_tree)[node] = tree::vp_node(p, mu, lc, rc, parent);
+
+            for(int c=0; c < 2; c++) {
+                ifloat* begin = c == 0 ? first : middle;
+                ifloat* end = c == 0 ? middle : last;
+                int child = c == 0 ? lc : rc;
+
+                if(pool != nullptr && end - begin >= VP_TREE_TASK_MIN)
+                    pool->push([this, begin, end, child, node, pool]() {
+                        this->make_subtree(begin, end, child, node, false, pool);
+                    });
+                else
+                    stack.push(std::make_tuple(begin, end, child, node));
+            }
+        }
+
+        if(stack.empty()) break;
+
+        std::tie(first, last, node, parent) = stack.top();
         stack.pop();
+    }
+}
 
-        p = this->select_vp(set_aux);
+///////////////////////////////////////////////////////////////////////////////
 
-        if(set_aux.size() == 1)
-            (*_tree).push_back(tree::vp_node(p, 0, LEAF, LEAF, parent));
-        else {
-            this->dist2(p, set_aux);
-            mu = this->split(set_aux, l_set, r_set);
+template <typename M>
+inline void tree::cpu::root_distances_t<M>::add(const dataset& data, 
+        size_t first, size_t n_points)
+{
+    ASSERT_FATAL_ERROR(first + n_points <= data.size(), "Out of bounds");
 
-            stack.push(std::pair<std::vector<ifloat>, int>(l_set, (*_tree).size()));
-            stack.push(std::pair<std::vector<ifloat>, int>(r_set, (*_tree).size()));
-        
-            (*_tree).push_back(tree::vp_node(p, mu, UNDEF, UNDEF, parent));
-        }
- 
-        if((*_tree)[parent]._rc == UNDEF)
-            (*_tree)[parent]._rc = (*_tree).size()-1;
-        else if((*_tree)[parent]._lc == UNDEF)
-            (*_tree)[parent]._lc = (*_tree).size()-1;
-        else
-            FATAL_ERROR("Binary node has more than two childs :(");
+    _dist.resize(data.size());
+
+    // The first point is needed for any distance
+    if(!_root_added && first != 0) {
+        _pending.push_back(std::make_pair(first, n_points));
+        return;
+    }
+    _root_added = true;
+
+    metric::cpu::batch::distances(_metric, data, data.row(0), first, n_points, &_dist[first]);
+    _n_added += n_points;
+
+    while(!_pending.empty()) {
+        std::pair<size_t, size_t> range = _pending.back();
+        _pending.pop_back();
+        this->add(data, range.first, range.second);
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline void tree::cpu::vp_tree::dist2(int p, std::vector<ifloat>& index_set) const
+template <typename M>
+inline void tree::cpu::vp_tree_t<M>::dist2(point_id p, ifloat* first, ifloat* last, 
+        scratch& buffers, int n_threads) const
 {
-    for(int i=0; i < index_set.size(); i++)
-        index_set[i].val() = _metric(p, index_set[i].key(), *_data, _dim);
+    size_t n = last - first;
+
+    // Capacity of the buffers only grows, no allocation once the largest set is seen
+    buffers.ids.resize(n);
+    buffers.dist.resize(n);
+
+    for(size_t i=0; i < n; i++) buffers.ids[i] = first[i].key();
+
+    metric::cpu::batch::distances(_metric, *_data, _data->row(p), buffers.ids.data(), n, 
+            buffers.dist.data(), n_threads);
+
+    for(size_t i=0; i < n; i++) first[i].val() = buffers.dist[i];
 }
 
 ///////////////////////////////////////////////////////////////////////////////
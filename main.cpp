@@ -11,8 +11,14 @@
 
 #include "parser.hpp"
 #include "reader_xtc.hpp"
+#include "reader_ndx.hpp"
 
 #include "vp_tree_cpu.hpp"
+#include "quantized.hpp"
+#include "rmsd.hpp"
+#include "alignment.hpp"
+#include "pca.hpp"
+#include "projection.hpp"
 
 #include "dbscan_cpu.hpp"
 
@@ -83,7 +89,20 @@ void print_data(const std::vector<float>& data, int max = 20, int dim = 3)
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void test_tree(int query, int kn, float dist, const tree::cpu::vp_tree* vptree);
+template <typename M>
+void test_tree(point_id query, int kn, float dist, const tree::cpu::vp_tree_t<M>* vptree);
+
+/*! \brief Checks the knn of the tree and clusters its points with dbscan */
+template <typename M>
+void cluster_tree(std::shared_ptr<const dataset> data, const tree::cpu::vp_tree_t<M>* vptree);
+
+/*! \brief Builds the vp-tree of data for metric and clusters its points */
+template <typename M>
+void cluster_metric(std::shared_ptr<const dataset> data, const M& metric);
+
+/*! \brief Clusters data with the euclidean metric, unrolled for the small
+ * dimentions left by a projection */
+void cluster_euclidean(std::shared_ptr<const dataset> data);
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -96,56 +115,250 @@ int main(int argc, const char **argv)
 {
     /* Adds arguments to the parser */
     console::parser::add_argument("-t", "List of trajectory files to read in, separated by spaces.");
-    console::parser::add_argument("-a", "List of atom index files to read in, separated by spaces.");
+    console::parser::add_argument("-a", "Atom index file and group to keep, as file.ndx[:group] (default: all atoms, first group if no group).");
     console::parser::add_argument("-p", "Topology file.");
     console::parser::add_argument("-o", "Home dir.");
     console::parser::add_argument("-k", "Resolution of the cluster algorithm");
     console::parser::add_argument("-m", "Min samples for Density based clustering algorithm");
-    console::parser::add_argument("-e", "Percentage to keep in each iteration");
+    console::parser::add_argument("-e", "Percentage of the frames to keep, drawn at random (default: 100)");
+    console::parser::add_argument("-s", "Stride between frames read (default: 1)");
+    console::parser::add_argument("-tb", "Time (ps) of the first frame read in each trajectory (default: start)");
+    console::parser::add_argument("-te", "Time (ps) of the last frame read in each trajectory (default: end)");
+    console::parser::add_argument("-q", "Compute distances on int16 quantized coordinates, 1 or 0 (default: 0)");
+    console::parser::add_argument("-r", "Use the RMSD after optimal superposition as distance, 1 or 0 (default: 0)");
+    console::parser::add_argument("-al", "Passes superposing the frames on the first one, then on their average, before clustering (default: 0)");
+    console::parser::add_argument("-jl", "Dimentions of a sparse random projection of the frames, before the principal components (default: 0, no projection)");
+    console::parser::add_argument("-pca", "Fraction of the variance kept by projecting the frames on their principal components, in (0, 1] (default: 0, no projection)");
+    console::parser::add_argument("-j", "Number of threads reading the trajectories (default: all)");
+    console::parser::add_argument("-v", "Read the velocities of .trr files after the positions, 1 or 0 (default: 0)");
+    console::parser::add_argument("-pl", "Start building the vp-tree while the trajectories are read, 1 or 0 (default: 0)");
+    console::parser::add_argument("-hp", "Store the coordinates in huge pages, 1 or 0 (default: 0)");
+    console::parser::add_argument("-is", "Instruction set of the distance kernels, scalar, sse2, avx2 or avx512 (default: widest supported)");
 
     console::parser::parse(argc, argv); // Parses the input parameters
 
     /* Starts parameters of the program */
     std::string trajlist = console::parser::get("-t", true);
-    std::string atom_index = console::parser::get("-a", true);
+    std::string atom_index = console::parser::get("-a", false);
     std::string topology = console::parser::get("-p", true);
     std::string home_dir = (console::parser::get("-o", false).size() == 1 ? "" : console::parser::get("-o", false));
     int k = std::stoi(console::parser::get("-k", true));
     int m = std::stoi(console::parser::get("-m", true));
-    int e = std::stof(console::parser::get("-e", true));
+    std::string e = console::parser::get("-e", false);
+    std::string begin_time = console::parser::get("-tb", false);
+    std::string end_time = console::parser::get("-te", false);
+    int stride = std::stoi(console::parser::get("-s", false));
+    int n_threads = std::stoi(console::parser::get("-j", false));
+    bool quantize = std::stoi(console::parser::get("-q", false));
+    bool rmsd = std::stoi(console::parser::get("-r", false));
+    int align = std::stoi(console::parser::get("-al", false));
+    int sketch = std::stoi(console::parser::get("-jl", false));
+    float variance = std::stof(console::parser::get("-pca", false));
+    bool velocities = std::stoi(console::parser::get("-v", false));
+    bool pipeline = std::stoi(console::parser::get("-pl", false));
+    bool huge_pages = std::stoi(console::parser::get("-hp", false));
+    std::string isa = console::parser::get("-is", false);
 
     /* Reads the trajectory list and acquires the data and number of atoms */
-    std::vector<float> data;
     int n_atoms;
 
-    reader_xtc::read_list(home_dir, trajlist, data, n_atoms);
+    if(console::parser::given("-a")) 
+        reader_ndx::read(home_dir, atom_index, reader_xtc::selection());
+
+    if(console::parser::given("-e")) reader_xtc::keep_fraction() = std::stof(e) / 100.0f;
+    if(console::parser::given("-tb")) reader_xtc::begin_time() = std::stof(begin_time);
+    if(console::parser::given("-te")) reader_xtc::end_time() = std::stof(end_time);
+    reader_xtc::stride() = stride;
+    reader_xtc::velocities() = velocities;
+
+    reader_xtc::n_threads() = n_threads;
+    if(huge_pages) dataset::default_storage() = dataset::HUGE_PAGES;
+
+    /* Kernel of the distances, the widest one unless another is asked */
+    if(console::parser::given("-is")) {
+        bool found = false;
+        for(int i=metric::cpu::simd::SCALAR; i <= metric::cpu::simd::AVX512; i++) {
+            metric::cpu::simd::isa_t candidate = (metric::cpu::simd::isa_t)i;
+            if(metric::cpu::simd::name(candidate) != isa) continue;
+            found = true;
+            if(!metric::cpu::simd::use(candidate)) 
+                WARNING_ERROR("Instruction set not supported: " + isa);
+        }
+        if(!found) FATAL_ERROR("Unknown instruction set: " + isa);
+    }
+    DBG_MESSAGE("Distance kernel: " + metric::cpu::simd::name(metric::cpu::simd::isa()) + "\n");
+
+    if(quantize && rmsd)
+        FATAL_ERROR("Quantized distances and RMSD can't be used together");
+    else if(rmsd && (variance > 0.0f || sketch > 0))
+        FATAL_ERROR("RMSD needs the frames, not their projection");
+    else if((rmsd || align > 0) && velocities)
+        FATAL_ERROR("RMSD and alignment need frames of positions only, without velocities");
+
+    /* Distances to the root of the vp-tree, computed while frames are decoded */
+    tree::cpu::root_distances_t<metric::cpu::euclidean_t> root;
+    reader_xtc::frames_ready_f ready;
+
+    if(pipeline && (quantize || rmsd || align > 0 || variance > 0.0f || sketch > 0)) 
+        WARNING_ERROR("Pipelined build only available with euclidean distances on the frames read");
+    else if(pipeline)
+        ready = [&root](const dataset& data, size_t first, size_t n_frames) {
+            root.add(data, first, n_frames);
+        };
 
-    std::shared_ptr<const std::vector<float>> shared_data = std::make_shared<const std::vector<float>>(data);
+    std::shared_ptr<dataset> data = std::make_shared<dataset>();
 
     TIME_BETWEEN(
-    tree::cpu::vp_tree* vptree = new tree::cpu::vp_tree(shared_data, n_atoms * 3);
+    reader_xtc::read_list(home_dir, trajlist, *data, n_atoms, ready);
     )
 
-    float dist = 0.51;
-    int kn = 5, query = 132;
-    test_tree(query, kn, dist, vptree);
+    /* Frames superposed in place, euclidean distances then close to RMSD */
+    if(align > 0) {
+        metric::cpu::alignment alignment;
+
+        alignment.fit(*data, align);
+
+        DBG_MESSAGE("Aligned " + std::to_string(data->size()) + " frames in " + 
+                std::to_string(alignment.n_passes()) + " passes (" + 
+                std::to_string(alignment.throughput()) + " frames/s)\n");
+    }
+
+    /* Frames sketched on a few dimentions, distances kept up to the distortion bound */
+    if(sketch > 0) {
+        metric::cpu::sparse_projection projection(data->dim(), sketch);
+        double eps = metric::cpu::sparse_projection::distortion(data->size(), sketch);
+
+        TIME_BETWEEN(
+        data = std::make_shared<dataset>(projection.transform(*data));
+        )
+
+        DBG_MESSAGE("Projected " + std::to_string(projection.dim()) + " coordinates on " + 
+                std::to_string(sketch) + "\n");
+        if(eps < 1.0)
+            DBG_MESSAGE("Squared distances within 1 +- " + std::to_string(eps) + 
+                    " with probability 1 - 1/" + std::to_string(data->size()) + "\n");
+        else 
+            WARNING_ERROR("Distortion not bounded, " + std::to_string(
+                        metric::cpu::sparse_projection::min_components(data->size(), 0.5)) + 
+                    " dimentions bound it to 0.5");
+    }
+
+    /* Frames projected on the principal components explaining the variance asked */
+    if(variance > 0.0f) {
+        metric::cpu::pca pca;
+
+        TIME_BETWEEN(
+        pca.fit(*data, variance);
+        data = std::make_shared<dataset>(pca.transform(*data));
+        )
+
+        DBG_MESSAGE("Projected " + std::to_string(pca.dim()) + " coordinates on " + 
+                std::to_string(pca.n_components()) + " components, explaining " + 
+                std::to_string(100.0 * pca.explained()) + "% of the variance\n");
+    }
+
+    /* Quantized points replacing the floats, the tree is on the int16 values */
+    if(quantize) {
+        metric::cpu::quantized_data quantization(*data);
+        std::shared_ptr<const dataset> quantized = 
+            std::make_shared<dataset>(quantization.transform(*data));
+
+        data.reset(); // Only the quantized points are kept
+
+        DBG_MESSAGE("Quantized distances, max error: " + std::to_string(quantization.max_error()) + "\n");
+
+        TIME_BETWEEN(
+        tree::cpu::vp_tree_t<metric::cpu::quantized_t>* vptree = 
+            new tree::cpu::vp_tree_t<metric::cpu::quantized_t>(quantized, quantization);
+        )
+
+        cluster_tree(quantized, vptree);
+
+        delete vptree;
+
+        return 0;
+    }
+
+    std::shared_ptr<const dataset> shared_data = data;
+
+    /* Frames centered in place, the metric only keeps their inner products */
+    if(rmsd) {
+        if(data->dim() / 3 < 2)
+            FATAL_ERROR("RMSD needs at least 2 atoms, " + std::to_string(data->dim() / 3) + " selected");
+
+        metric::cpu::rmsd_data centered(*data);
+
+        DBG_MESSAGE("RMSD distances after optimal superposition\n");
 
+        cluster_metric(shared_data, metric::cpu::rmsd_t(centered));
+    }
+    /* Tree split at its root by the distances computed during the reading */
+    else if(ready) {
+        TIME_BETWEEN(
+        tree::cpu::vp_tree_t<metric::cpu::euclidean_t>* vptree = 
+            new tree::cpu::vp_tree_t<metric::cpu::euclidean_t>(shared_data, root);
+        )
+
+        cluster_tree(shared_data, vptree);
+
+        delete vptree;
+    }
+    else 
+        cluster_euclidean(shared_data);
+
+    //print_data(data, 123);
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename M>
+void cluster_metric(std::shared_ptr<const dataset> data, const M& metric)
+{
     TIME_BETWEEN(
-    cluster::cpu::dbscan* dbscan = new cluster::cpu::dbscan(shared_data, dist, kn, n_atoms * 3, *vptree);
+    tree::cpu::vp_tree_t<M>* vptree = new tree::cpu::vp_tree_t<M>(data, metric);
     )
 
-    //print_data(data, 123);
+    cluster_tree(data, vptree);
 
-    delete (tree::cpu::vp_tree*)vptree;
+    delete vptree;
+}
 
-    return 0;
+///////////////////////////////////////////////////////////////////////////////
+
+void cluster_euclidean(std::shared_ptr<const dataset> data)
+{
+    switch(data->dim())
+    {
+        case 3: cluster_metric(data, metric::cpu::fixed_euclidean_t<3>()); break;
+        case 8: cluster_metric(data, metric::cpu::fixed_euclidean_t<8>()); break;
+        case 16: cluster_metric(data, metric::cpu::fixed_euclidean_t<16>()); break;
+        case 32: cluster_metric(data, metric::cpu::fixed_euclidean_t<32>()); break;
+        default: cluster_metric(data, metric::cpu::euclidean_t()); break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename M>
+void cluster_tree(std::shared_ptr<const dataset> data, const tree::cpu::vp_tree_t<M>* vptree)
+{
+    float dist = 0.51;
+    int kn = 5, query = 132;
+    test_tree(query, kn, dist, vptree);
+
+    TIME_BETWEEN(
+    cluster::cpu::dbscan_t<M>* dbscan = new cluster::cpu::dbscan_t<M>(data, dist, kn, *vptree);
+    )
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void test_tree(int query, int kn, float dist, const tree::cpu::vp_tree* vptree)
+template <typename M>
+void test_tree(point_id query, int kn, float dist, const tree::cpu::vp_tree_t<M>* vptree)
 {
-    std::vector<int> id1, id2;
+    std::vector<point_id> id1, id2;
  
     std::cout << console::modifier(console::FG_MAGENTA) << "knn epsilon:" << 
         console::modifier(console::FG_DEFAULT) << std::endl;
@@ -153,21 +366,21 @@ void test_tree(int query, int kn, float dist, const tree::cpu::vp_tree* vptree)
     TIME_BETWEEN(
     vptree->stack_knn(query, dist, id1);
     )
-    print_vec<int>(id1);
+    print_vec<point_id>(id1);
 
     TIME_BETWEEN(
     vptree->knn(query, dist, id1);
     )
-    print_vec<int>(id1);
+    print_vec<point_id>(id1);
 
     std::cout << console::modifier(console::FG_MAGENTA) << "brute knn epsilon:" << 
         console::modifier(console::FG_DEFAULT) << std::endl;
     TIME_BETWEEN(
     vptree->brute_knn(query, dist, id2);
     )
-    print_vec<int>(id2);
+    print_vec<point_id>(id2);
 
-    if(cmp_vec<int>(id2, id1))
+    if(cmp_vec<point_id>(id2, id1))
         DBG_MESSAGE("Brute and knn algorithms are equal ! :)\n");
     else
         DBG_MESSAGE("Error in knn algorithm :(\n");
@@ -178,21 +391,21 @@ void test_tree(int query, int kn, float dist, const tree::cpu::vp_tree* vptree)
     TIME_BETWEEN(
     vptree->stack_knn(query, kn, id1);
     )
-    print_vec<int>(id1);
+    print_vec<point_id>(id1);
 
     TIME_BETWEEN(
     vptree->knn(query, kn, id1);
     )
-    print_vec<int>(id1);
+    print_vec<point_id>(id1);
 
     std::cout << console::modifier(console::FG_MAGENTA) << "brute knn:" << 
         console::modifier(console::FG_DEFAULT) << std::endl;
     TIME_BETWEEN(
     vptree->brute_knn(query, kn, id2);
     )
-    print_vec<int>(id2);
+    print_vec<point_id>(id2);
 
-    if(cmp_vec<int>(id2, id1))
+    if(cmp_vec<point_id>(id2, id1))
         DBG_MESSAGE("Brute and knn algorithms are equal ! :)\n");
     else
         DBG_MESSAGE("Error in knn algorithm :(\n");
@@ -61,6 +61,15 @@ namespace console
              * */
             static inline const std::string get(const std::string& arg, bool required);
 
+            /*!
+             * \brief Checks whether the argument was given in the CLI
+             *
+             * Values of optional arguments equal to DEFAULT_STRING, "-e 0"
+             * for instance, can only be told from missing arguments this way
+             * \param arg short form of the parameter. Ex: "-t", "-a", etc
+             * */
+            static inline bool given(const std::string& arg);
+
         protected:
             /**
              * \brief Prints the help in CLI
@@ -118,6 +127,13 @@ inline const std::string console::parser::get(const std::string& arg, bool requi
 
 ///////////////////////////////////////////////////////////////////////////////
 
+inline bool console::parser::given(const std::string& arg)
+{
+    return console::parser::_arguments.count(arg) && console::parser::_raw_input.count(arg);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 inline void console::parser::parse(int argc, const char** argv)
 {
     console::parser::_prog_name = argv[0];
@@ -0,0 +1,103 @@
+/*============================================================================*/
+/*! \file fixed_metric.cpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-17 10:05
+ *
+ *  \brief Vp-tree knn with the euclidean metric of fixed dimention
+ *
+ *  This file contains a test building vp-trees on the fixed dimention
+ *  euclidean metric for the dimentions main dispatches to it, and checking
+ *  its distances against euclidean_t and the knn of the trees against
+ *  brute force
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "vp_tree_cpu.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Number of points of each dataset */
+#define FIXED_N_POINTS 3000
+
+/*! \brief Largest relative difference with euclidean_t */
+#define FIXED_TOLERANCE 1e-5f
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Sorts the ids, the tree and the brute force don't order ties alike */
+static std::vector<point_id> sorted(std::vector<point_id> id)
+{
+    std::sort(id.begin(), id.end());
+
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Compares the tree of fixed_euclidean_t<N> with brute force on
+ * gaussian points
+ * \return number of queries or distances that differ */
+template <int N>
+static int check()
+{
+    std::shared_ptr<dataset> data(new dataset(FIXED_N_POINTS, N));
+    std::mt19937 rand(N);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    metric::cpu::fixed_euclidean_t<N> fixed;
+    metric::cpu::euclidean_t euclidean;
+    std::vector<point_id> tree_id, brute_id;
+    int errors = 0;
+
+    for(size_t i=0; i < data->size(); i++)
+        for(int d=0; d < N; d++) data->row(i)[d] = normal(rand);
+
+    for(size_t i=1; i < data->size(); i++) {
+        float expected = euclidean(data->row(0), data->row(i), N);
+
+        if(!(std::fabs(fixed(data->row(0), data->row(i), N) - expected) <= FIXED_TOLERANCE * expected))
+            errors++;
+    }
+
+    std::shared_ptr<const dataset> points = data;
+    tree::cpu::vp_tree_t<metric::cpu::fixed_euclidean_t<N>> vptree(points);
+    // Radius of about 10 neighbours
+    float radius = std::sqrt(2.0f * N) * std::pow(10.0f / FIXED_N_POINTS, 1.0f / N);
+
+    for(point_id query=0; query < FIXED_N_POINTS; query+=97) {
+        vptree.knn(query, 5, tree_id);
+        vptree.brute_knn(query, 5, brute_id);
+        if(sorted(tree_id) != sorted(brute_id)) errors++;
+
+        vptree.knn(query, radius, tree_id);
+        vptree.brute_knn(query, radius, brute_id);
+        if(sorted(tree_id) != sorted(brute_id)) errors++;
+
+        vptree.stack_knn(query, radius, tree_id);
+        if(sorted(tree_id) != sorted(brute_id)) errors++;
+    }
+
+    std::printf("dimention %d: %d differ\n", N, errors);
+
+    return errors;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    int errors = check<3>() + check<8>() + check<16>() + check<32>();
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
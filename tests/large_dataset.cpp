@@ -0,0 +1,90 @@
+/*============================================================================*/
+/*! \file large_dataset.cpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 23:10
+ *
+ *  \brief Vp-tree knn on a dataset of more than 2^31 floats
+ *
+ *  This file contains a test building a vp-tree on a memory mapped dataset
+ *  holding more than 2^31 floats, so that the rows past the 32-bit float
+ *  offsets are used, and checking that the knn of the tree are the ones
+ *  found by brute force. Only a few floats per row are set, the untouched
+ *  pages are never reserved
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "vp_tree_cpu.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Number of points of the dataset */
+#define LARGE_N_POINTS 8
+
+/*! \brief Dimention of the points, LARGE_N_POINTS rows of it pass 2^31 floats */
+#define LARGE_DIMENTION ((1 << 28) + 16)
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Sorts the ids, the tree and the brute force don't order ties alike */
+static std::vector<point_id> sorted(std::vector<point_id> id)
+{
+    std::sort(id.begin(), id.end());
+
+    return id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    std::shared_ptr<dataset> data(new dataset(LARGE_N_POINTS, LARGE_DIMENTION, dataset::MMAP));
+    std::vector<point_id> tree_id, brute_id;
+    int errors = 0;
+
+    if(data->size() * data->stride() <= ((size_t)1 << 31)) {
+        std::fprintf(stderr, "%zu floats, not more than 2^31\n", data->size() * data->stride());
+        return EXIT_FAILURE;
+    }
+
+    // Points on a line, with a small offset in the first coordinate so
+    // the distances of a query to its neighbours differ
+    for(size_t i=0; i < data->size(); i++) {
+        data->row(i)[0] = (float)(i % 3);
+        data->row(i)[LARGE_DIMENTION - 1] = (float)i;
+    }
+
+    std::shared_ptr<const dataset> points = data;
+    tree::cpu::vp_tree vptree(points);
+
+    // Every query reads all the rows, the first, middle and last points
+    // are enough
+    for(point_id query : {0, LARGE_N_POINTS / 2, LARGE_N_POINTS - 1}) {
+        vptree.knn(query, 3, tree_id);
+        vptree.brute_knn(query, 3, brute_id);
+        if(sorted(tree_id) != sorted(brute_id)) {
+            std::fprintf(stderr, "k nearest neighbours of %d differ from brute force\n", query);
+            errors++;
+        }
+
+        vptree.knn(query, 2.5f, tree_id);
+        vptree.brute_knn(query, 2.5f, brute_id);
+        if(sorted(tree_id) != sorted(brute_id) || tree_id.empty()) {
+            std::fprintf(stderr, "Neighbours of %d in radius differ from brute force\n", query);
+            errors++;
+        }
+    }
+
+    std::printf("%zu points of dimention %d, %d queries differ\n", data->size(), data->dim(), errors);
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,70 @@
+/*============================================================================*/
+/*! \file simd_bench.cpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 23:30
+ *
+ *  \brief Benchmark of the squared distance kernels
+ *
+ *  This file contains a benchmark timing every squared euclidean distance
+ *  kernel the processor supports, between the rows of a dataset. Usage:
+ *  simd_bench [dimention] [number of points]
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "dataset.hpp"
+#include "metrics_simd.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Number of passes over all the pairs of points */
+#define BENCH_REPEAT 5
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+    int dim = argc > 1 ? std::stoi(argv[1]) : 10000;
+    size_t n_points = argc > 2 ? std::stoul(argv[2]) : 64;
+    dataset data(n_points, dim, dataset::HEAP);
+
+    std::srand(42);
+    for(size_t i=0; i < data.size(); i++)
+        for(int j=0; j < dim; j++)
+            data[i][j] = (float)std::rand() / RAND_MAX;
+
+    std::printf("%zu points of dimention %d\n", n_points, dim);
+
+    for(int i=metric::cpu::simd::SCALAR; i <= metric::cpu::simd::supported(); i++) {
+        metric::cpu::simd::isa_t isa = (metric::cpu::simd::isa_t)i;
+        metric::cpu::squared_f kernel = metric::cpu::simd::kernel(isa);
+        volatile float sink = 0.0f;
+        size_t calls = 0;
+
+        if(kernel == NULL) continue;
+
+        auto start = std::chrono::steady_clock::now();
+        for(int r=0; r < BENCH_REPEAT; r++) {
+            for(size_t a=0; a < data.size(); a++) {
+                for(size_t b=0; b < data.size(); b++) {
+                    sink = sink + kernel(data[a], data[b], dim);
+                    calls++;
+                }
+            }
+        }
+        std::chrono::duration<double, std::micro> time = std::chrono::steady_clock::now() - start;
+
+        std::printf("%-8s %10.3f us per call\n", metric::cpu::simd::name(isa).c_str(),
+                time.count() / calls);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,101 @@
+/*============================================================================*/
+/*! \file simd_kernels.cpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 23:30
+ *
+ *  \brief Vectorized squared distance kernels against the scalar one
+ *
+ *  This file contains a test running every squared euclidean distance
+ *  kernel the processor supports on points of odd and even dimentions, at
+ *  unaligned offsets, and checking the results against the scalar kernel.
+ *  The floats after the points are NaN, so a kernel reading past dim
+ *  fails the test
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <limits>
+
+#include "metrics_simd.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Largest offset in floats of the points from the buffer start */
+#define SIMD_MAX_OFFSET 16
+
+/*! \brief Largest relative difference with the scalar kernel */
+#define SIMD_TOLERANCE 1e-5f
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Compares kernel to the scalar one on points of dimention dim
+ * \return number of offsets where they differ */
+static int check(metric::cpu::simd::isa_t isa, int dim)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    metric::cpu::squared_f kernel = metric::cpu::simd::kernel(isa);
+    std::vector<float> a(dim + 2 * SIMD_MAX_OFFSET), b(dim + 2 * SIMD_MAX_OFFSET);
+    int errors = 0;
+
+    for(int offset=0; offset < SIMD_MAX_OFFSET; offset++) {
+        // b is shifted too, so a and b are not aligned alike
+        int offset_b = (offset * 5 + 3) % SIMD_MAX_OFFSET;
+
+        for(size_t i=0; i < a.size(); i++) a[i] = nan;
+        for(size_t i=0; i < b.size(); i++) b[i] = nan;
+        for(int i=0; i < dim; i++) {
+            a[offset + i] = (float)std::rand() / RAND_MAX * 2.0f - 1.0f;
+            b[offset_b + i] = (float)std::rand() / RAND_MAX * 2.0f - 1.0f;
+        }
+
+        float expected = metric::cpu::squared_euclidean_scalar(&a[offset], &b[offset_b], dim);
+        float res = kernel(&a[offset], &b[offset_b], dim);
+
+        if(!(std::fabs(res - expected) <= SIMD_TOLERANCE * expected)) {
+            std::fprintf(stderr, "%s: dim %d, offsets %d %d: %g, scalar %g\n",
+                    metric::cpu::simd::name(isa).c_str(), dim, offset, offset_b, res, expected);
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    metric::cpu::simd::isa_t supported = metric::cpu::simd::supported();
+    std::vector<int> dims;
+    int errors = 0;
+
+    for(int dim=0; dim <= 300; dim++) dims.push_back(dim);
+    dims.push_back(1023);
+    dims.push_back(1024);
+    dims.push_back(4099);
+    dims.push_back(10001);
+
+    std::srand(42);
+
+    for(int i=metric::cpu::simd::SCALAR; i <= supported; i++) {
+        metric::cpu::simd::isa_t isa = (metric::cpu::simd::isa_t)i;
+        int isa_errors = 0;
+
+        if(metric::cpu::simd::kernel(isa) == NULL) continue;
+
+        for(int dim : dims) isa_errors += check(isa, dim);
+
+        std::printf("%s: %zu dimentions, %d differ\n", metric::cpu::simd::name(isa).c_str(),
+                dims.size(), isa_errors);
+        errors += isa_errors;
+    }
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
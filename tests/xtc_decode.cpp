@@ -0,0 +1,101 @@
+/*============================================================================*/
+/*! \file xtc_decode.cpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 22:40
+ *
+ *  \brief Fast XTC decoder against the reference one
+ *
+ *  This file contains a test decoding every frame of a trajectory twice,
+ *  with the fast decoder of xdrfile and with the reference one, and
+ *  checking that coordinates, box, step, time and precision are the same
+ *  bytes. Usage: xtc_decode file.xtc
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "xdrfile/xdrfile.h"
+#include "xdrfile/xdrfile_xtc.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief One decoded frame */
+struct frame
+{
+    int step;              /*!< step of the frame */
+    float time;            /*!< time of the frame */
+    float prec;            /*!< precision of the frame */
+    matrix box;            /*!< box of the frame */
+    std::vector<float> x;  /*!< coordinates of the frame */
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Decodes every frame of path with the fast decoder or the
+ * reference one */
+static std::vector<frame> decode(const char* path, int n_atoms, int fast)
+{
+    std::vector<frame> frames;
+    XDRFILE* xd = xdrfile_open(path, "r");
+    frame f;
+
+    if(xd == NULL) {
+        std::fprintf(stderr, "Can't open %s\n", path);
+        std::exit(EXIT_FAILURE);
+    }
+
+    xdrfile_set_fast_decompress(fast);
+
+    f.x.resize(3 * n_atoms);
+    while(read_xtc(xd, n_atoms, &f.step, &f.time, f.box, (rvec*)f.x.data(), &f.prec) == exdrOK)
+        frames.push_back(f);
+
+    xdrfile_close(xd);
+
+    return frames;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+    int n_atoms, errors = 0;
+
+    if(argc != 2 || read_xtc_natoms(argv[1], &n_atoms) != exdrOK) {
+        std::fprintf(stderr, "Usage: %s file.xtc\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<frame> fast = decode(argv[1], n_atoms, 1);
+    std::vector<frame> reference = decode(argv[1], n_atoms, 0);
+
+    if(fast.size() != reference.size() || fast.empty()) {
+        std::fprintf(stderr, "%zu frames decoded, %zu by the reference decoder\n", 
+                fast.size(), reference.size());
+        return EXIT_FAILURE;
+    }
+
+    for(size_t i=0; i < fast.size(); i++) {
+        const frame& a = fast[i];
+        const frame& b = reference[i];
+
+        if(std::memcmp(a.x.data(), b.x.data(), a.x.size() * sizeof(float)) != 0 ||
+                std::memcmp(a.box, b.box, sizeof(matrix)) != 0 || a.step != b.step || 
+                std::memcmp(&a.time, &b.time, sizeof(float)) != 0 ||
+                std::memcmp(&a.prec, &b.prec, sizeof(float)) != 0) {
+            std::fprintf(stderr, "Frame %zu differs from the reference decoder\n", i);
+            errors++;
+        }
+    }
+
+    std::printf("%zu frames of %d atoms, %d differ\n", fast.size(), n_atoms, errors);
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,130 @@
+/*============================================================================*/
+/*! \file xtc_stream.cpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-17 09:20
+ *
+ *  \brief Batches of xtc_stream against read_list
+ *
+ *  This file contains a test reading a trajlist with xtc_stream, for
+ *  several batch sizes, numbers of threads, strides, subsamplings and atom
+ *  selections, and checking that the batches put one after the other are
+ *  the frames read_list returns, also after a rewind(). Usage: xtc_stream
+ *  home trajlist
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "reader_xtc.hpp"
+#include "xtc_stream.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Reading options of one run of the comparison */
+struct options
+{
+    int n_threads;              /*!< threads reading the files */
+    int stride;                 /*!< stride between frames */
+    float keep_fraction;        /*!< fraction of frames kept */
+    std::vector<int> selection; /*!< atoms kept, all if empty */
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Reads the stream once to its end and compares each batch with
+ * the frames of reference
+ * \return number of batches that differ, or 1 if the frame count differs */
+static int compare(xtc_stream& stream, const dataset& reference, size_t batch_size)
+{
+    size_t frame_size = stream.n_atoms() * 3, n_frames = 0;
+    int errors = 0;
+
+    while(stream.next()) {
+        bool same = stream.first() == n_frames && stream.size() <= batch_size &&
+            n_frames + stream.size() <= reference.size();
+
+        for(size_t i=0; same && i < stream.size(); i++)
+            same = std::memcmp(stream.data() + i * frame_size, reference[n_frames + i],
+                    frame_size * sizeof(float)) == 0;
+
+        if(!same) errors++;
+        n_frames += stream.size();
+    }
+
+    return n_frames == reference.size() && !stream.next() ? errors : errors + 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+    std::vector<options> runs = {
+        {1, 1, 1.0f, {}},
+        {3, 1, 1.0f, {}},
+        {2, 3, 1.0f, {}},
+        {4, 1, 0.5f, {}},
+        {3, 2, 0.7f, {199, 0, 17, 5, 100}},
+    };
+    std::vector<size_t> batch_sizes = {1, 7, 64, 1000};
+    int errors = 0;
+
+    if(argc != 3) {
+        std::fprintf(stderr, "Usage: %s home trajlist\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Nothing is written next to the sample
+    reader_xtc::use_cache() = false;
+    reader_xtc::save_index() = false;
+    reader_xtc::seed() = 7;
+
+    for(const options& run : runs) {
+        dataset reference;
+        int n_atoms;
+
+        reader_xtc::n_threads() = run.n_threads;
+        reader_xtc::stride() = run.stride;
+        reader_xtc::keep_fraction() = run.keep_fraction;
+        reader_xtc::selection() = run.selection;
+
+        reader_xtc::read_list(argv[1], argv[2], reference, n_atoms);
+
+        for(size_t batch_size : batch_sizes) {
+            xtc_stream stream(argv[1], argv[2], batch_size);
+            int run_errors = 0;
+
+            if(stream.n_atoms() != n_atoms || stream.n_frames() != reference.size()) {
+                std::fprintf(stderr, "Stream of %zu frames of %d atoms, read_list %zu of %d\n",
+                        stream.n_frames(), stream.n_atoms(), reference.size(), n_atoms);
+                errors++;
+                continue;
+            }
+
+            run_errors += compare(stream, reference, batch_size);
+
+            // Whole stream again, then from a rewind in the middle of it
+            stream.rewind();
+            run_errors += compare(stream, reference, batch_size);
+
+            stream.rewind();
+            stream.next();
+            stream.rewind();
+            run_errors += compare(stream, reference, batch_size);
+
+            std::printf("%d threads, stride %d, keep %.1f, %d atoms, batches of %zu: "
+                    "%zu frames, %d batches differ\n", run.n_threads, run.stride,
+                    run.keep_fraction, n_atoms, batch_size, reference.size(), run_errors);
+            errors += run_errors;
+        }
+    }
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
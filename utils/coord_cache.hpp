@@ -0,0 +1,209 @@
+/*============================================================================*/
+/*! \file coord_cache.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 12:40
+ *
+ *  \brief Binary cache of decoded coordinates
+ *
+ *  This file contains the implementation of a cache storing the coordinates
+ *  read from a trajlist as raw floats, so later runs on the same files don't
+ *  decompress them again. The rows are stored as in a dataset, so a loaded
+ *  cache is used straight from its memory map
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef COORD_CACHE_HPP
+#define COORD_CACHE_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <boost/filesystem.hpp>
+
+#include "error.hpp"
+#include "dataset.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Extension appended to the trajlist name for the cache file */
+#define COORD_CACHE_EXT ".cache"
+
+/*! \brief Magic bytes at the start of cache files */
+#define COORD_CACHE_MAGIC "CRDCACH3"
+
+/*! \brief Alignment in bytes of the coordinates in the cache file */
+#define COORD_CACHE_ALIGNMENT DATASET_ALIGNMENT
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Cache of the coordinates read from a list of trajectory files
+ *
+ * File layout, in native byte order:
+ *  - magic, COORD_CACHE_MAGIC without the final '\\0'
+ *  - uint64 size of the header, offset of the coordinates
+ *  - uint64 n_frames, int n_atoms, uint64 stride of the rows
+ *  - uint64 size and bytes of the settings, see key
+ *  - uint64 n_files, then for each file: uint64 length and bytes of the
+ *    path, uint64 size, int64 modification time
+ *  - padding up to a multiple of COORD_CACHE_ALIGNMENT
+ *  - n_frames rows of stride floats, each one a frame of n_atoms * 3
+ *    floats and its padding, as the rows of a dataset
+ * */
+class coord_cache
+{
+    public:
+        /*! \brief Loads the coordinates cached in cache_file
+         *
+         * The cache is only used if it was written for the same files, in
+         * the same version (size and modification time), and with the same
+         * settings key. The rows of data are mapped from the file, nothing
+         * is copied
+         * \param key settings of the reader changing the coordinates read
+         * (atom selection, frame selection, ...)
+         * \return false if the cache is missing or outdated
+         * */
+        static inline bool load(const std::string& cache_file,
+                const std::vector<std::string>& trajlist, const std::string& key,
+                dataset& data, int& n_atoms);
+
+        /*! \brief Writes the coordinates of trajlist in cache_file
+         *
+         * The file is written under a temporary name and renamed, so a
+         * partly written cache is never loaded
+         * \return false if the file could not be written
+         * */
+        static inline bool save(const std::string& cache_file,
+                const std::vector<std::string>& trajlist, const std::string& key,
+                const dataset& data, int n_atoms);
+
+    protected:
+        /*! \brief Builds the header of a cache, without the size of the
+         * coordinates, which ends at an aligned offset */
+        static inline std::string header(const std::vector<std::string>& trajlist,
+                const std::string& key, uint64_t n_frames, int n_atoms);
+
+        /*! \brief Appends the bytes of value to str */
+        template <typename T>
+        static inline void append(std::string& str, const T& value)
+            {str.append((const char*)&value, sizeof(T));}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline std::string coord_cache::header(const std::vector<std::string>& trajlist,
+        const std::string& key, uint64_t n_frames, int n_atoms)
+{
+    std::string str(COORD_CACHE_MAGIC);
+    size_t size_offset;
+
+    size_offset = str.size();
+    coord_cache::append(str, (uint64_t)0); // size of the header, set below
+
+    coord_cache::append(str, n_frames);
+    coord_cache::append(str, n_atoms);
+    coord_cache::append(str, (uint64_t)dataset::stride(n_atoms * 3));
+
+    coord_cache::append(str, (uint64_t)key.size());
+    str += key;
+
+    coord_cache::append(str, (uint64_t)trajlist.size());
+    for(const std::string& file : trajlist)
+    {
+        coord_cache::append(str, (uint64_t)file.size());
+        str += file;
+        coord_cache::append(str, (uint64_t)boost::filesystem::file_size(file));
+        coord_cache::append(str, (int64_t)boost::filesystem::last_write_time(file));
+    }
+
+    // Coordinates start aligned
+    str.resize((str.size() + COORD_CACHE_ALIGNMENT - 1) / COORD_CACHE_ALIGNMENT * COORD_CACHE_ALIGNMENT, '\0');
+
+    uint64_t size = str.size();
+    memcpy(&str[size_offset], &size, sizeof(size));
+
+    return str;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline bool coord_cache::load(const std::string& cache_file,
+        const std::vector<std::string>& trajlist, const std::string& key,
+        dataset& data, int& n_atoms)
+{
+    const size_t magic_size = sizeof(COORD_CACHE_MAGIC) - 1;
+    std::ifstream in(cache_file, std::ios_base::in | std::ios_base::binary);
+    uint64_t header_size, n_frames;
+    std::string head, expected;
+    int atoms;
+
+    if(!in) return false;
+
+    head.resize(magic_size + 2 * sizeof(uint64_t) + sizeof(int));
+    if(!in.read(&head[0], head.size())) return false;
+
+    memcpy(&header_size, &head[magic_size], sizeof(header_size));
+    memcpy(&n_frames, &head[magic_size + sizeof(header_size)], sizeof(n_frames));
+    memcpy(&atoms, &head[magic_size + 2 * sizeof(uint64_t)], sizeof(atoms));
+    if(atoms <= 0) return false;
+
+    // The header must be the one this run would write
+    expected = coord_cache::header(trajlist, key, n_frames, atoms);
+    if(header_size != expected.size()) return false;
+
+    head.resize(header_size);
+    in.seekg(0);
+    if(!in.read(&head[0], header_size) || head != expected) return false;
+
+    if(boost::filesystem::file_size(cache_file) != 
+            header_size + n_frames * dataset::stride(atoms * 3) * sizeof(float))
+        return false;
+
+    if(!data.map(cache_file, header_size, n_frames, atoms * 3)) return false;
+    n_atoms = atoms;
+
+    DBG_MESSAGE("Read cache: " + cache_file + " ... " + std::to_string(n_frames) +
+            " frames found\n"); // Debug Message
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline bool coord_cache::save(const std::string& cache_file,
+        const std::vector<std::string>& trajlist, const std::string& key,
+        const dataset& data, int n_atoms)
+{
+    std::string tmp_file = cache_file + ".tmp";
+    uint64_t n_frames = data.size();
+    std::string head = coord_cache::header(trajlist, key, n_frames, n_atoms);
+
+    {
+        std::ofstream out(tmp_file, std::ios_base::out | std::ios_base::binary);
+
+        if(!out) return false;
+
+        out.write(head.data(), head.size());
+        out.write((const char*)data.data(), data.bytes());
+
+        if(!out) {
+            out.close();
+            std::remove(tmp_file.c_str());
+            return false;
+        }
+    }
+
+    return std::rename(tmp_file.c_str(), cache_file.c_str()) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !COORD_CACHE_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,266 @@
+/*============================================================================*/
+/*! \file dataset.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 15:20
+ *
+ *  \brief Aligned and padded storage of the points
+ *
+ *  This file contains the implementation of a class storing points as rows
+ *  of floats starting at 64 bytes aligned addresses, in memory taken from
+ *  the heap, from an anonymous memory map, from huge pages or from a file
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef DATASET_HPP
+#define DATASET_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "error.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Alignment in bytes of each row of a dataset */
+#define DATASET_ALIGNMENT 64
+
+/*! \brief Size in bytes of the huge pages */
+#define DATASET_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Points of dimention dim, stored in rows of stride floats
+ *
+ * The stride is dim rounded up to a multiple of DATASET_ALIGNMENT bytes and
+ * the padding floats are zero, so kernels can read whole vectors up to the
+ * end of a row and a row never shares a cache line with another one. Points
+ * are addressed by their index, row(i) being point i
+ * */
+class dataset
+{
+    public:
+        /*! \brief Memory backing the rows */
+        enum storage_t
+        {
+            HEAP,       /*!< aligned allocation on the heap */
+            MMAP,       /*!< anonymous memory map, not reserved, or a file for map() */
+            HUGE_PAGES  /*!< anonymous memory map on huge pages */
+        };
+
+        /*! \brief Constructs an empty dataset */
+        dataset() : _data(NULL), _size(0), _dim(0), _stride(0),
+            _storage(HEAP), _map(NULL), _map_size(0) {}
+
+        /*! \brief Constructs a dataset of n_points zeroed points
+         *
+         * \param storage memory backing the rows, default_storage() if not
+         * given
+         * */
+        inline dataset(size_t n_points, int dim, storage_t storage);
+        dataset(size_t n_points, int dim) : dataset(n_points, dim, _default_storage) {}
+
+        /*! \brief Frees the rows */
+        inline ~dataset() {this->release();}
+
+        /*! \brief Moves the rows of other to a new dataset */
+        inline dataset(dataset&& other) : dataset() {this->swap(other);}
+        /*! \brief Moves the rows of other to this dataset */
+        inline dataset& operator=(dataset&& other) {this->swap(other); return *this;}
+
+        /*! \brief Maps the rows stored in a file, without copying them
+         *
+         * The file must hold n_points rows of stride(dim) floats starting at
+         * offset, a multiple of DATASET_ALIGNMENT. Pages are copied on write
+         * and the file is never modified. If default_storage() is HUGE_PAGES,
+         * the map is advised to use huge pages
+         * \return false if the file could not be mapped
+         * */
+        inline bool map(const std::string& file, size_t offset, size_t n_points, int dim);
+
+        /*! \brief Get point i */
+        inline const float* row(size_t i) const {return _data + i * _stride;}
+        /*! \brief Set point i */
+        inline float* row(size_t i) {return _data + i * _stride;}
+        /*! \brief Get point i */
+        inline const float* operator[](size_t i) const {return this->row(i);}
+        /*! \brief Set point i */
+        inline float* operator[](size_t i) {return this->row(i);}
+
+        /*! \brief Get first row, size()*stride() floats */
+        inline const float* data() const {return _data;}
+        /*! \brief Set rows */
+        inline float* data() {return _data;}
+        /*! \brief Get number of points */
+        inline size_t size() const {return _size;}
+        /*! \brief Get dimention of the points */
+        inline int dim() const {return _dim;}
+        /*! \brief Get number of floats between two rows */
+        inline size_t stride() const {return _stride;}
+        /*! \brief Get memory backing the rows */
+        inline storage_t storage() const {return _storage;}
+        /*! \brief Get size in bytes of the rows */
+        inline size_t bytes() const {return _size * _stride * sizeof(float);}
+
+        /*! \brief Number of floats between two rows of points of dimention dim */
+        static inline size_t stride(int dim)
+        {
+            const size_t align = DATASET_ALIGNMENT / sizeof(float);
+            return (dim + align - 1) / align * align;
+        }
+
+        /*! \brief Set memory backing the datasets constructed without
+         * storage. Default: HEAP */
+        static inline storage_t& default_storage() {return _default_storage;}
+
+    protected:
+        dataset(const dataset&) = delete;
+        dataset& operator=(const dataset&) = delete;
+
+        /*! \brief Frees the rows and empties the dataset */
+        inline void release();
+
+        /*! \brief Exchanges the rows of this dataset and of other */
+        inline void swap(dataset& other);
+
+        float* _data;      /*!< first row, aligned */
+        size_t _size;      /*!< number of points */
+        int _dim;          /*!< dimention of the points */
+        size_t _stride;    /*!< floats between two rows */
+        storage_t _storage; /*!< memory backing the rows */
+
+        void* _map;        /*!< memory map, if the rows are mapped */
+        size_t _map_size;  /*!< size in bytes of the memory map */
+
+        static storage_t _default_storage; /*!< storage of new datasets */
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+dataset::storage_t dataset::_default_storage = dataset::HEAP;
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline dataset::dataset(size_t n_points, int dim, storage_t storage) :
+    dataset()
+{
+    size_t bytes;
+    void* ptr = NULL;
+
+    ASSERT_FATAL_ERROR(dim > 0, "Dimention must be positive");
+
+    _size = n_points;
+    _dim = dim;
+    _stride = dataset::stride(dim);
+    _storage = storage;
+
+    bytes = this->bytes();
+    if(bytes == 0) return;
+
+    if(storage == HUGE_PAGES)
+    {
+        // Whole huge pages, falls back on transparent huge pages
+        _map_size = (bytes + DATASET_HUGE_PAGE_SIZE - 1) / DATASET_HUGE_PAGE_SIZE * DATASET_HUGE_PAGE_SIZE;
+        _map = mmap(NULL, _map_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(_map == MAP_FAILED) {
+            _map = mmap(NULL, _map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(_map != MAP_FAILED) madvise(_map, _map_size, MADV_HUGEPAGE);
+        }
+    }
+    else if(storage == MMAP)
+    {
+        // Pages are only backed once written, rows may exceed the memory
+        _map_size = bytes;
+        _map = mmap(NULL, _map_size, PROT_READ | PROT_WRITE, 
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    else if(posix_memalign(&ptr, DATASET_ALIGNMENT, bytes) == 0)
+        memset(ptr, 0, bytes);
+
+    if(_map == MAP_FAILED) _map = NULL;
+    if(_map != NULL) ptr = _map; // anonymous maps are zeroed
+
+    if(ptr == NULL) FATAL_ERROR("Cannot allocate " + std::to_string(bytes) + " bytes of points");
+    _data = (float*)ptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline bool dataset::map(const std::string& file, size_t offset, size_t n_points, int dim)
+{
+    size_t bytes = n_points * dataset::stride(dim) * sizeof(float);
+    struct stat st;
+    void* map;
+    int fd;
+
+    if(offset % DATASET_ALIGNMENT || dim <= 0) return false;
+
+    if((fd = open(file.c_str(), O_RDONLY)) < 0) return false;
+
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < offset + bytes || offset + bytes == 0) {
+        close(fd);
+        return false;
+    }
+
+    // Only the pages written are copied, so nothing is reserved for them
+    map = mmap(NULL, offset + bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) return false;
+
+    // A file can not be mapped on huge pages, but its copied pages can
+    if(_default_storage == HUGE_PAGES && madvise(map, offset + bytes, MADV_HUGEPAGE) != 0)
+        WARNING_ERROR("Huge pages not available for " + file);
+
+    this->release();
+
+    _map = map;
+    _map_size = offset + bytes;
+    _data = (float*)((char*)map + offset);
+    _size = n_points;
+    _dim = dim;
+    _stride = dataset::stride(dim);
+    _storage = MMAP;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void dataset::release()
+{
+    if(_map != NULL) munmap(_map, _map_size);
+    else free(_data);
+
+    _data = NULL; _map = NULL; _map_size = 0;
+    _size = 0; _dim = 0; _stride = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void dataset::swap(dataset& other)
+{
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+    std::swap(_dim, other._dim);
+    std::swap(_stride, other._stride);
+    std::swap(_storage, other._storage);
+    std::swap(_map, other._map);
+    std::swap(_map_size, other._map_size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !DATASET_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,149 @@
+/*============================================================================*/
+/*! \file reader_ndx.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 11:20
+ *
+ *  \brief Reader of Gromacs .ndx index files
+ *
+ *  This file contains the implementation of a class for reading the groups of
+ *  atoms of a Gromacs index file (.ndx). A group is a list of 1 based atom
+ *  numbers following a "[ name ]" line
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef READER_NDX_HPP
+#define READER_NDX_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+#include "error.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Separator between the index file and the group name */
+#define NDX_GROUP_SEPARATOR ':'
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Class for reading atom groups of .ndx files */
+class reader_ndx
+{
+    public:
+        /*! \brief Reads the atoms of the group selected by spec
+         *
+         * spec has the form "file.ndx[:group]", the first group of the file
+         * being used when no group is given. group can be the name of the
+         * group or its position in the file, starting at 0. The path of the
+         * file is home/file.ndx
+         * \param atoms 0 based indexes of the atoms of the group
+         * */
+        static inline void read(const std::string& home, const std::string& spec,
+                std::vector<int>& atoms);
+
+        /*! \brief Reads the atoms of a group of an index file
+         *
+         * \param group name or position of the group. If empty, the first
+         * group is read
+         * \param atoms 0 based indexes of the atoms of the group
+         * */
+        static inline void read_group(const std::string& ndx_file,
+                const std::string& group, std::vector<int>& atoms);
+
+    protected:
+        /*! \brief Reads the name of a group from a "[ name ]" line
+         *
+         * \return true if line is a group header
+         * */
+        static inline bool group_name(const std::string& line, std::string& name);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void reader_ndx::read(const std::string& home, const std::string& spec,
+        std::vector<int>& atoms)
+{
+    size_t sep = spec.rfind(NDX_GROUP_SEPARATOR);
+    std::string ndx_file = home + spec, group;
+
+    // The separator is only a group separator if the file part exists
+    if(sep != std::string::npos && !boost::filesystem::is_regular_file(home + spec)) {
+        ndx_file = home + spec.substr(0, sep);
+        group = spec.substr(sep + 1);
+    }
+
+    reader_ndx::read_group(ndx_file, group, atoms);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void reader_ndx::read_group(const std::string& ndx_file,
+        const std::string& group, std::vector<int>& atoms)
+{
+    std::ifstream in(ndx_file, std::ios_base::in);
+    std::string line, name, selected;
+    bool found = false, in_group = false;
+    int position = -1, atom;
+
+    if(!in) FATAL_ERROR(ndx_file + ": File not found :(");
+
+    atoms.clear();
+
+    while(std::getline(in, line))
+    {
+        if(reader_ndx::group_name(line, name)) {
+            if(found) break; // end of the selected group
+
+            position++;
+            in_group = group.empty() || name == group || std::to_string(position) == group;
+            found = in_group;
+            if(found) selected = name;
+        }
+        else if(in_group) {
+            std::stringstream numbers(line);
+
+            while(numbers >> atom) {
+                if(atom < 1) FATAL_ERROR(ndx_file + ": Invalid atom number " + std::to_string(atom));
+                atoms.push_back(atom - 1); // .ndx atom numbers start at 1
+            }
+        }
+    }
+
+    if(!found) FATAL_ERROR(ndx_file + ": Group \"" + group + "\" not found :(");
+    if(atoms.empty()) FATAL_ERROR(ndx_file + ": Group \"" + selected + "\" is empty :(");
+
+    DBG_MESSAGE("Read index group: " + selected + " ... " + std::to_string(atoms.size()) +
+            " atoms found\n"); // Debug Message
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline bool reader_ndx::group_name(const std::string& line, std::string& name)
+{
+    size_t open = line.find('['), close = line.rfind(']');
+    size_t first, last;
+
+    if(open == std::string::npos || close == std::string::npos || close < open)
+        return false;
+
+    // Strips the spaces around the name
+    first = line.find_first_not_of(" \t", open + 1);
+    last = line.find_last_not_of(" \t", close - 1);
+
+    name = (first < close && last >= first) ? line.substr(first, last - first + 1) : "";
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !READER_NDX_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
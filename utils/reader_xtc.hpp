@@ -3,7 +3,7 @@
  *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
  *  \date 2015-03-30 18:49 
  *
- *  \brief .xtc file reader 
+ *  \brief .xtc and .trr file reader
  *
  *  This file contains the implementation of a class for reading .xtc files 
  *  with a trajectory list
@@ -21,12 +21,27 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <limits>
+#include <queue>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
 #include <boost/filesystem.hpp>
 
 #include "error.hpp"
+#include "dataset.hpp"
+#include "xtc_index.hpp"
+#include "thread_pool.hpp"
+#include "coord_cache.hpp"
 
 #include "xdrfile/xdrfile.h"
 #include "xdrfile/xdrfile_xtc.h"
+#include "xdrfile/xdrfile_trr.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -39,24 +54,165 @@ namespace bfs = boost::filesystem;
 
 ///////////////////////////////////////////////////////////////////////////////
 
-/*! \brief Class for reading trajlist and .xtc files */
+/*! \brief Class for reading trajlist and .xtc or .trr files
+ *
+ * Both formats go through the same index, selection and decoding path, and
+ * can be mixed in a trajlist. Only the positions are read from .trr files,
+ * followed by the velocities if velocities() is set
+ * */
 class reader_xtc
 {
     public:
+        /*! \brief Function called on a range of frames already decoded
+         *
+         * \param data coordinates being read, one frame per point
+         * \param first number of the first frame of the range
+         * \param n_frames number of frames of the range
+         * */
+        using frames_ready_f = std::function<void(const dataset& data, 
+                size_t first, size_t n_frames)>;
+
         /*! \brief Reads all trajectories specified in the trajlist file. 
          *
          * A trajlist file can contains the relative paths to the .xtc files or name of
          * files that contains relative paths to the .xtc files. The absolute
          * path is always done in the following way : path = home/trajlist
+         *
+         * The frames are counted first, using the frame index of each file,
+         * so data is allocated only once and every frame is decoded directly
+         * at its final place, the row of its point. Only the frames kept by
+         * the time window, the stride and the fraction to keep are decoded,
+         * see select_frames
+         *
+         * If use_cache() is set, the coordinates are mapped from the cache
+         * file home/trajlist.cache when it matches the files and the
+         * settings of the reader, and written to it otherwise
+         *
+         * If ready is given, it's called on the calling thread for each range
+         * of frames as soon as it's decoded, while the reading threads go on
+         * with the next ones, so the frames can be processed during the
+         * reading. Ranges come in the order they are decoded, not the order
+         * of the frames, and cover every frame once. data is never
+         * reallocated after the first call. A cached trajlist is handed over
+         * in a single range
+         * */
+        static inline void read_list(const std::string& home, const std::string& trajlist,
+                dataset& data, int& n_atoms, 
+                const frames_ready_f& ready = frames_ready_f());
+
+        /*! \brief Reads all trajectories specified in the trajlist file.
+         *
+         * Same as read_list(home, trajlist, data, n_atoms) but the data is
+         * returned in a shared dataset ready to be used by the vp-tree and
+         * the clusterers, without any copy
+         * */
+        static inline std::shared_ptr<const dataset> read_list(
+                const std::string& home, const std::string& trajlist, int& n_atoms,
+                const frames_ready_f& ready = frames_ready_f());
+
+        /*! \brief Reads all trajectories specified in the trajlist file.
+         *
+         * Same as read_list(home, trajlist, data, n_atoms) but the frames
+         * are copied one after the other in a vector, without padding
          * */
         static inline void read_list(const std::string& home, const std::string& trajlist,
                 std::vector<float>& data, int& n_atoms);
 
+        /*! \brief Set whether trajectory files are read through a memory map
+         *
+         * Enabled by default. When a file can not be mapped the reader falls
+         * back to the stdio stream
+         * */
+        static inline bool& use_mmap() {return _use_mmap;}
+
+        /*! \brief Set number of threads used for reading the trajlist
+         *
+         * Files are indexed concurrently and ranges of frames, of one or
+         * several files, are decoded concurrently at their final place in
+         * data, so frame indexes don't depend on the scheduling. If smaller
+         * than 1 the number of hardware threads is used
+         * */
+        static inline int& n_threads() {return _n_threads;}
+
+        /*! \brief Gets the frame index of a trajectory file
+         *
+         * The index is loaded from the sidecar file of trajfile if it's up
+         * to date. Otherwise it's built with a scan of the frame headers and
+         * saved in the sidecar file for the next runs
+         * */
+        static inline void get_index(const std::string& trajfile, xtc_index& index);
+
+        /*! \brief Reads the frames [first, last) of a trajectory file
+         *
+         * The file is opened directly at the offset of frame first, the
+         * frames before it are not decoded. The frames are appended to data
+         * \param index frame index of trajfile, see get_index
+         * */
+        static inline void read_frames(const std::string& trajfile, 
+                const xtc_index& index, size_t first, size_t last, 
+                std::vector<float>& data);
+
+        /*! \brief Set whether frame indexes are saved in sidecar files 
+         *
+         * Enabled by default. Disable it for read-only trajectory folders
+         * */
+        static inline bool& save_index() {return _save_index;}
+
+        /*! \brief Set atoms kept in each frame
+         *
+         * 0 based indexes of the atoms, see reader_ndx. Only the coordinates
+         * of these atoms are stored, in the order of the selection, and
+         * n_atoms becomes the number of selected atoms. Empty by default,
+         * meaning every atom is kept
+         * */
+        static inline std::vector<int>& selection() {return _selection;}
+
+        /*! \brief Set time (ps) of the first frame read from each file 
+         *
+         * Frames before it are skipped. Default: -infinity */
+        static inline float& begin_time() {return _begin_time;}
+
+        /*! \brief Set time (ps) of the last frame read from each file
+         *
+         * Frames after it are skipped. Default: +infinity */
+        static inline float& end_time() {return _end_time;}
+
+        /*! \brief Set stride between frames read, inside the time window of
+         * each file. Values smaller than 1 mean every frame */
+        static inline int& stride() {return _stride;}
+
+        /*! \brief Set fraction of the frames kept after the time window and
+         * the stride, in [0, 1]
+         *
+         * Each frame is kept with this probability. The draws come from a
+         * generator seeded with seed(), so a same trajlist always gives the
+         * same frames whatever the number of threads. Default: 1
+         * */
+        static inline float& keep_fraction() {return _keep_fraction;}
+
+        /*! \brief Set seed of the subsampling of keep_fraction() */
+        static inline unsigned int& seed() {return _seed;}
+
+        /*! \brief Set whether read_list uses a cache of the coordinates
+         *
+         * Enabled by default. See coord_cache
+         * */
+        static inline bool& use_cache() {return _use_cache;}
+
+        /*! \brief Set whether velocities are read after the positions
+         *
+         * Only .trr files can have velocities, every frame of every file
+         * must have them. Each frame then stores the positions of the kept
+         * atoms followed by their velocities, and n_atoms counts each atom
+         * twice, so frames still have n_atoms*3 floats. Disabled by default
+         * */
+        static inline bool& velocities() {return _velocities;}
+
     protected:
         /*! \brief Reads a trajectory file. 
          *
          * It can be *.xtc or any other file defined in _supported_ext vector 
-         * and appends the new trajectories in the data vector
+         * and appends the frames kept by select_frames in the data vector
          * */
         static inline void read_trajfile(const std::string& trajfile, std::vector<float>&
                 data, int& n_atoms, int& n_samples);
@@ -77,48 +233,383 @@ class reader_xtc
          * */
         static inline bool is_ext_supported(const std::string& file_name);
 
+        /*! \brief Opens a trajectory file for reading
+         *
+         * Uses the memory mapped stream if use_mmap() is set and the file can
+         * be mapped, the stdio stream otherwise
+         * */
+        static inline XDRFILE* open_trajfile(const std::string& trajfile);
+
+        /*! \brief Gets the frame index of each file of trajlist concurrently 
+         *
+         * \return total number of frames
+         * */
+        static inline size_t index_files(const std::vector<std::string>& trajlist,
+                std::vector<xtc_index>& indexes, int n_threads);
+
+        /*! \brief Selects the frames of a file to be read
+         *
+         * Frames without positions, .trr frames of velocities or forces
+         * only, are skipped. Applies then, in this order, the time window,
+         * the stride and the fraction to keep to the frames of index. Only
+         * the headers stored in the index are used, nothing is decoded
+         * \param rng generator of the subsampling, shared by the files
+         * \param frames numbers of the kept frames, in increasing order
+         * */
+        static inline void select_frames(const xtc_index& index, 
+                std::mt19937& rng, std::vector<size_t>& frames);
+
+        /*! \brief Decodes the selected frames of the files of trajlist in data
+         *
+         * The frames of each file are split in chunks decoded by a pool of
+         * n_threads threads, each chunk being decoded directly at its final
+         * place in data. data must have room for every frame of frames. If
+         * ready is given, the calling thread hands each chunk over to it
+         * once decoded
+         * */
+        static inline void decode_files(const std::vector<std::string>& trajlist,
+                const std::vector<xtc_index>& indexes, 
+                const std::vector<std::vector<size_t>>& frames, dataset& data, 
+                int n_threads, const frames_ready_f& ready);
+
+        /*! \brief Decodes the frames frames[0 .. n_frames-1] of trajfile in dest 
+         *
+         * Frames are read in the given order, the file being positioned with
+         * the index only when a frame doesn't follow the previous one, so
+         * skipped frames are never decompressed. dest must have room for
+         * n_frames frames of
+         * n_selected(index.n_atoms()) atoms. When atoms are selected, each
+         * frame is decoded in a temporary frame and only the selected atoms
+         * are copied to dest. The format is given by the extension of trajfile
+         * \param stride number of floats between the first floats of two
+         * frames in dest, 0 if the frames follow each other
+         * */
+        static inline void decode_frames(const std::string& trajfile, 
+                const xtc_index& index, const size_t* frames, size_t n_frames, float* dest,
+                size_t stride = 0);
+
+        /*! \brief Settings changing the coordinates read, as stored in the
+         * coordinate cache */
+        static inline std::string cache_key();
+
+        /*! \brief Number of atoms stored for frames of n_atoms atoms,
+         * velocities counting as atoms */
+        static inline int n_selected(int n_atoms) 
+            {return (_selection.empty() ? n_atoms : _selection.size()) * (_velocities ? 2 : 1);}
+
+        /*! \brief Prints the number of frames and the throughput of the
+         * reading of a file */
+        static inline void print_throughput(const std::string& trajfile, 
+                int n_samples, double seconds);
+
+        friend class xtc_stream; // reads the trajlist batch by batch
+
     private:
         static std::vector<std::string> _supported_ext; /*! list of supported extensions */
+
+        static bool _use_mmap; /*!< read files through a memory map */
+
+        static int _n_threads; /*!< number of threads reading files */
+
+        static bool _save_index; /*!< save frame indexes in sidecar files */
+
+        static std::vector<int> _selection; /*!< atoms kept in each frame */
+
+        static float _begin_time; /*!< time of the first frame read */
+        static float _end_time; /*!< time of the last frame read */
+        static int _stride; /*!< stride between frames read */
+        static float _keep_fraction; /*!< fraction of frames kept */
+        static unsigned int _seed; /*!< seed of the subsampling */
+
+        static bool _use_cache; /*!< use a cache of the coordinates */
+
+        static bool _velocities; /*!< read velocities after the positions */
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-std::vector<std::string> reader_xtc::_supported_ext = {".xtc"};
+std::vector<std::string> reader_xtc::_supported_ext = {".xtc", ".trr"};
+
+bool reader_xtc::_use_mmap = true;
+
+int reader_xtc::_n_threads = 0;
+
+bool reader_xtc::_save_index = true;
+
+std::vector<int> reader_xtc::_selection;
+
+float reader_xtc::_begin_time = -std::numeric_limits<float>::infinity();
+
+float reader_xtc::_end_time = std::numeric_limits<float>::infinity();
+
+int reader_xtc::_stride = 1;
+
+float reader_xtc::_keep_fraction = 1.0f;
+
+unsigned int reader_xtc::_seed = 0;
+
+bool reader_xtc::_use_cache = true;
+
+bool reader_xtc::_velocities = false;
 
 ///////////////////////////////////////////////////////////////////////////////
 
 inline void reader_xtc::read_list(const std::string& home, const std::string& trajlist_path, 
-        std::vector<float>& data, int& n_atoms)
+        dataset& data, int& n_atoms, const frames_ready_f& ready)
 {
     std::vector<std::string> trajlist;
-    int n_samples = 0;
+    std::vector<xtc_index> indexes;
+    std::vector<std::vector<size_t>> frames;
+    std::mt19937 rng(reader_xtc::_seed);
+    int n_threads = reader_xtc::_n_threads;
+    size_t n_samples = 0;
+
+    if(n_threads < 1) n_threads = thread_pool::hardware_threads();
 
     // Checks if file exists
     if(!bfs::is_regular_file(home+trajlist_path)) FATAL_ERROR(home+trajlist_path+": File not found :("); 
     reader_xtc::get_framefile_list(trajlist, home, trajlist_path);
 
-    data.clear(); // clears data
+    if(trajlist.size() <= 0) FATAL_ERROR("File list empty :("); 
+
+    // Coordinates already decoded by a previous run
+    if(reader_xtc::_use_cache && coord_cache::load(home + trajlist_path + COORD_CACHE_EXT,
+                trajlist, reader_xtc::cache_key(), data, n_atoms)) {
+        if(ready) ready(data, 0, data.size());
+        return;
+    }
+
+    // First pass: counts the frames of each file and selects the ones kept
+    reader_xtc::index_files(trajlist, indexes, n_threads);
+
+    frames.resize(indexes.size());
+    for(int i=0; i < indexes.size(); i++) {
+        reader_xtc::select_frames(indexes[i], rng, frames[i]);
+        n_samples += frames[i].size();
+    }
 
     // Number of atoms in the first file is number of atoms in all the files
-    if(trajlist.size() <= 0) FATAL_ERROR("File list empty :("); 
-    read_xtc_natoms((char*)trajlist[0].c_str(), &n_atoms);
+    for(int i=1; i < indexes.size(); i++) {
+        if(indexes[i].n_atoms() != indexes[0].n_atoms()) 
+            FATAL_ERROR(trajlist[i] + ": Number of atoms differs from " + trajlist[0]);
+    }
+    n_atoms = reader_xtc::n_selected(indexes[0].n_atoms());
+
+    // Second pass: decodes every frame at its final place
+    data = dataset(); // releases previous data 
+    data = dataset(n_samples, n_atoms * 3);
+
+    reader_xtc::decode_files(trajlist, indexes, frames, data, n_threads, ready);
+
+    if(reader_xtc::_use_cache && !coord_cache::save(home + trajlist_path + COORD_CACHE_EXT,
+                trajlist, reader_xtc::cache_key(), data, n_atoms))
+        WARNING_ERROR(home + trajlist_path + COORD_CACHE_EXT + ": Could not write the coordinate cache");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline std::string reader_xtc::cache_key()
+{
+    std::string key;
+
+    key.append((const char*)&reader_xtc::_begin_time, sizeof(float));
+    key.append((const char*)&reader_xtc::_end_time, sizeof(float));
+    key.append((const char*)&reader_xtc::_stride, sizeof(int));
+    key.append((const char*)&reader_xtc::_keep_fraction, sizeof(float));
+    key.append((const char*)&reader_xtc::_seed, sizeof(unsigned int));
+    key.append((const char*)&reader_xtc::_velocities, sizeof(bool));
+    key.append((const char*)reader_xtc::_selection.data(), reader_xtc::_selection.size() * sizeof(int));
+
+    return key;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline std::shared_ptr<const dataset> reader_xtc::read_list(
+        const std::string& home, const std::string& trajlist, int& n_atoms,
+        const frames_ready_f& ready)
+{
+    std::shared_ptr<dataset> data = std::make_shared<dataset>();
+
+    reader_xtc::read_list(home, trajlist, *data, n_atoms, ready);
+
+    return data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void reader_xtc::read_list(const std::string& home, const std::string& trajlist, 
+        std::vector<float>& data, int& n_atoms)
+{
+    dataset rows;
+
+    reader_xtc::read_list(home, trajlist, rows, n_atoms);
+
+    data.clear(); data.shrink_to_fit(); // releases previous data 
+    data.resize(rows.size() * rows.dim());
+    for(size_t i=0; i < rows.size(); i++)
+        std::copy(rows.row(i), rows.row(i) + rows.dim(), &data[i * rows.dim()]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline size_t reader_xtc::index_files(const std::vector<std::string>& trajlist,
+        std::vector<xtc_index>& indexes, int n_threads)
+{
+    size_t n_samples = 0;
+
+    indexes.clear();
+    indexes.resize(trajlist.size());
+
+    {
+        thread_pool pool(std::min(n_threads, (int)trajlist.size()));
+
+        for(int i=0; i < trajlist.size(); i++)
+            pool.push([&, i]() {reader_xtc::get_index(trajlist[i], indexes[i]);});
+
+        pool.wait();
+    }
+
+    for(int i=0; i < indexes.size(); i++) n_samples += indexes[i].size();
+
+    return n_samples;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void reader_xtc::select_frames(const xtc_index& index, 
+        std::mt19937& rng, std::vector<size_t>& frames)
+{
+    int stride = std::max(reader_xtc::_stride, 1);
+    // Frame kept if a draw of the 32 bits generator is below the threshold
+    double threshold = std::min(std::max(reader_xtc::_keep_fraction, 0.0f), 1.0f) * 4294967296.0;
+    size_t in_window = 0, no_positions = 0;
+
+    frames.clear();
+
+    for(size_t i=0; i < index.size(); i++)
+    {
+        if(!index.positions(i)) {
+            no_positions++;
+            continue;
+        }
+
+        if(index.time(i) < reader_xtc::_begin_time || index.time(i) > reader_xtc::_end_time)
+            continue;
+
+        if(in_window++ % stride) continue;
+
+        if(threshold < 4294967296.0 && rng() >= threshold) continue;
+
+        frames.push_back(i);
+    }
+
+    if(no_positions)
+        WARNING_ERROR(std::to_string(no_positions) + " frames without positions skipped");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void reader_xtc::decode_files(const std::vector<std::string>& trajlist,
+        const std::vector<xtc_index>& indexes, 
+        const std::vector<std::vector<size_t>>& frames, dataset& data, 
+        int n_threads, const frames_ready_f& ready)
+{
+    std::vector<std::vector<double>> seconds(trajlist.size());
+    size_t n_samples = 0, chunk, base = 0;
+
+    // Chunks decoded and not handed over to ready yet, (first frame, number of frames)
+    std::queue<std::pair<size_t, size_t>> decoded;
+    std::condition_variable decoded_cond;
+    std::mutex decoded_mutex;
+
+    for(int i=0; i < frames.size(); i++) n_samples += frames[i].size();
+    if(n_samples == 0) return;
+
+    // A few chunks per thread to balance files and frames of different sizes
+    chunk = (n_samples + n_threads * 4 - 1) / (n_threads * 4);
+
+    DBG_MESSAGE("Reading " + std::to_string(n_samples) + " frames of " + 
+            std::to_string(trajlist.size()) + " files with " + 
+            std::to_string(n_threads) + " threads\n"); // Debug Message
 
-    // Foreach file in trajlist
-    for(std::string trajfile : trajlist)
     {
-        DBG_MESSAGE("Reading file: " + trajfile + " ... "); // Debug Message
-        reader_xtc::read_trajfile(trajfile, data, n_atoms, n_samples);
-        DBG_MESSAGE(std::to_string(n_samples) + " frames found\n"); // Debug Message
+        thread_pool pool(n_threads);
+
+        for(int i=0; i < trajlist.size(); i++)
+        {
+            seconds[i].resize((frames[i].size() + chunk - 1) / chunk, 0.0);
+
+            for(size_t first=0; first < frames[i].size(); first += chunk)
+            {
+                size_t last = std::min(first + chunk, frames[i].size());
+                double* time = &seconds[i][first / chunk];
+                size_t chunk_first = base + first;
+
+                pool.push([&, i, first, last, time, chunk_first]() {
+                    auto t0 = std::chrono::high_resolution_clock::now();
+                    reader_xtc::decode_frames(trajlist[i], indexes[i], 
+                            &frames[i][first], last - first, data.row(chunk_first), data.stride());
+                    auto t1 = std::chrono::high_resolution_clock::now();
+                    *time = std::chrono::duration<double>(t1-t0).count();
+
+                    if(ready) {
+                        std::lock_guard<std::mutex> lock(decoded_mutex);
+                        decoded.push(std::make_pair(chunk_first, last - first));
+                        decoded_cond.notify_one();
+                    }
+                });
+            }
+
+            base += frames[i].size();
+        }
+
+        // Hands the chunks over while the next ones are decoded
+        for(size_t handed = 0; ready && handed < n_samples; ) {
+            std::pair<size_t, size_t> range;
+            {
+                std::unique_lock<std::mutex> lock(decoded_mutex);
+                decoded_cond.wait(lock, [&]() {return !decoded.empty();});
+                range = decoded.front(); decoded.pop();
+            }
+
+            ready(data, range.first, range.second);
+            handed += range.second;
+        }
+
+        pool.wait();
+    }
+
+    // Time spent decoding each file, over all its chunks
+    for(int i=0; i < trajlist.size(); i++) {
+        double time = 0.0;
+        for(double t : seconds[i]) time += t;
+        reader_xtc::print_throughput(trajlist[i], frames[i].size(), time);
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+inline void reader_xtc::print_throughput(const std::string& trajfile, 
+        int n_samples, double seconds)
+{
+    double mbytes = bfs::file_size(trajfile) / (1024.0 * 1024.0);
+    std::stringstream msg;
+
+    msg << "Read file: " << trajfile << " ... " << n_samples << " frames found (";
+    msg << mbytes << " MB in " << seconds << "s, " << mbytes / seconds << " MB/s, ";
+    msg << n_samples / seconds << " frames/s)\n";
+
+    DBG_MESSAGE(msg.str()); // Debug Message
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 inline bool reader_xtc::is_ext_supported(const std::string& str)
 {
     for(std::string l : reader_xtc::_supported_ext)
     {
-        if(!str.compare(str.size()-4, 4, l))
+        if(str.size() >= l.size() && !str.compare(str.size()-l.size(), l.size(), l))
             return true;
     }
     return false;
@@ -126,6 +617,113 @@ inline bool reader_xtc::is_ext_supported(const std::string& str)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+inline XDRFILE* reader_xtc::open_trajfile(const std::string& trajfile)
+{
+    XDRFILE *xdr_file = NULL;
+
+    if(reader_xtc::_use_mmap)
+        xdr_file = xdrfile_open_mmap(trajfile.c_str());
+    if(xdr_file == NULL)
+        xdr_file = xdrfile_open(trajfile.c_str(), "r");
+    if(xdr_file == NULL) FATAL_ERROR(trajfile+": Could not open file :(");
+
+    return xdr_file;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void reader_xtc::get_index(const std::string& trajfile, xtc_index& index)
+{
+    if(index.load(trajfile))
+        return;
+
+    XDRFILE *xdr_file = reader_xtc::open_trajfile(trajfile); // opens file
+    index.build(trajfile, xdr_file);
+    xdrfile_close(xdr_file);
+
+    if(reader_xtc::_save_index && !index.save(trajfile))
+        WARNING_ERROR(xtc_index::sidecar(trajfile) + ": Could not write frame index");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void reader_xtc::read_frames(const std::string& trajfile, 
+        const xtc_index& index, size_t first, size_t last, 
+        std::vector<float>& data)
+{
+    size_t begin = data.size();
+    std::vector<size_t> frames;
+
+    last = std::min(last, index.size());
+    if(first >= last) return;
+
+    frames.resize(last - first);
+    std::iota(frames.begin(), frames.end(), first);
+
+    // Decodes directly at the end of data
+    data.resize(begin + frames.size() * reader_xtc::n_selected(index.n_atoms()) * 3);
+    reader_xtc::decode_frames(trajfile, index, frames.data(), frames.size(), &data[begin]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void reader_xtc::decode_frames(const std::string& trajfile, 
+        const xtc_index& index, const size_t* frames, size_t n_frames, float* dest,
+        size_t stride)
+{
+    int step, n_atoms = index.n_atoms();
+    float time, prec, lambda;
+    matrix box;
+    bool trr = xtc_index::is_trr(trajfile);
+    std::vector<float> frame; // whole frame when atoms are selected
+
+    for(int atom : reader_xtc::_selection) {
+        if(atom >= n_atoms) FATAL_ERROR(trajfile + ": Selected atom " + 
+                std::to_string(atom + 1) + " not in the frames");
+    }
+    if(reader_xtc::_velocities && !index.velocities())
+        FATAL_ERROR(trajfile + ": Velocities not in every frame");
+    if(!reader_xtc::_selection.empty()) frame.resize(n_atoms * 3 * (reader_xtc::_velocities ? 2 : 1));
+
+    XDRFILE *xdr_file = reader_xtc::open_trajfile(trajfile); // opens file
+
+    if(stride == 0) stride = reader_xtc::n_selected(n_atoms) * 3;
+
+    for(size_t i=0, next=index.size(); i < n_frames; next = frames[i++] + 1) {
+        float* out = dest + i * stride;
+        rvec* x = (rvec*)(frame.empty() ? out : frame.data());
+        rvec* v = reader_xtc::_velocities ? x + n_atoms : NULL; // after the positions
+        int result;
+
+        if(!index.positions(frames[i]))
+            FATAL_ERROR(trajfile + ": No positions in frame " + std::to_string(frames[i]));
+
+        // Jumps over the skipped frames without decoding them
+        if(frames[i] != next && xdrfile_seek(xdr_file, index.offset(frames[i]), SEEK_SET) != exdrOK) 
+            FATAL_ERROR(trajfile + ": Could not seek to frame " + std::to_string(frames[i]));
+
+        if(trr) result = read_trr(xdr_file, n_atoms, &step, &time, &lambda, box, x, v, NULL);
+        else result = read_xtc(xdr_file, n_atoms, &step, &time, box, x, &prec);
+
+        if(result != exdrOK)
+            FATAL_ERROR(trajfile + ": Could not read frame " + std::to_string(frames[i]));
+
+        if(frame.empty()) continue;
+
+        // Keeps only the selected atoms, positions then velocities
+        for(rvec* src = x; src != NULL; src = (src == x ? v : NULL)) {
+            for(int atom : reader_xtc::_selection) {
+                *out++ = src[atom][0]; *out++ = src[atom][1]; *out++ = src[atom][2];
+            }
+        }
+    }
+
+    // Closes trajfile
+    xdrfile_close(xdr_file);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 inline void reader_xtc::get_framefile_list(std::vector<std::string>& trajlist,
         const std::string& home, const std::string& trajlinks_path)
 {
@@ -147,6 +745,10 @@ inline void reader_xtc::get_framefile_list(std::vector<std::string>& trajlist,
                 reader_xtc::get_framefile_list(trajlist, home, sub_traj);
             else if(bfs::is_regular_file(home+sub_traj+".xtc")) // if file without xtc extension
                 trajlist.push_back(home+sub_traj+".xtc");
+            else if(bfs::is_regular_file(home+sub_traj+".trr")) // if file without trr extension
+                trajlist.push_back(home+sub_traj+".trr");
+            else if(bfs::is_regular_file(home+sub_traj+"/frame0.trr"))
+                trajlist.push_back(home+sub_traj+"/frame0.trr");
             else  // default file name
                 trajlist.push_back(home+sub_traj+"/frame0.xtc");
 
@@ -160,30 +762,21 @@ inline void reader_xtc::get_framefile_list(std::vector<std::string>& trajlist,
 inline void reader_xtc::read_trajfile(const std::string& trajfile, 
         std::vector<float> &data, int& n_atoms, int& n_samples)
 {
-    int step;
-    float time, prec;
-    matrix box;
-    rvec* tmp = new rvec[n_atoms];
-    n_samples = 0;
-
-    // Opens trajfile
-    XDRFILE *xdr_file = xdrfile_open(trajfile.c_str(), "r"); // opens file
-
-    // Reads each frame
-    while (exdrOK == read_xtc(xdr_file, n_atoms, &step, &time, box, tmp, &prec)) {
-        for(int i=0; i < n_atoms; i++) {
-            data.push_back(tmp[i][0]);
-            data.push_back(tmp[i][1]);
-            data.push_back(tmp[i][2]);
-        }
-        n_samples++;
-    }
+    xtc_index index;
+    std::vector<size_t> frames;
+    std::mt19937 rng(reader_xtc::_seed);
+    size_t begin = data.size();
 
-    // Closes trajfile
-    xdrfile_close(xdr_file);
+    // Counts the frames first so data grows only once
+    reader_xtc::get_index(trajfile, index);
+    reader_xtc::select_frames(index, rng, frames);
+
+    n_samples = frames.size();
+    n_atoms = reader_xtc::n_selected(index.n_atoms());
 
-    // Deletes allocated memory
-    delete []tmp;
+    // Decodes directly at the end of data
+    data.resize(begin + frames.size() * n_atoms * 3);
+    reader_xtc::decode_frames(trajfile, index, frames.data(), frames.size(), &data[begin]);
 }
 
 
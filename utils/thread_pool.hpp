@@ -0,0 +1,162 @@
+/*============================================================================*/
+/*! \file thread_pool.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 09:12
+ *
+ *  \brief Simple pool of worker threads
+ *
+ *  This file contains the implementation of a fixed size pool of threads
+ *  consuming tasks from a shared queue. It's necessary to have C++11 support
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <queue>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Fixed size pool of threads executing tasks in FIFO order */
+class thread_pool
+{
+    public:
+        /*! \brief Starts the pool
+         *
+         * \param n_threads number of worker threads. If smaller than 1 the
+         * number of hardware threads is used
+         * */
+        thread_pool(int n_threads = 0);
+
+        /*! \brief Waits for the queued tasks and joins the workers */
+        ~thread_pool();
+
+        /*! \brief Queues a task to be executed by one of the workers */
+        inline void push(std::function<void()> task);
+
+        /*! \brief Blocks until every queued task has finished */
+        inline void wait();
+
+        /*! \brief Get number of worker threads */
+        inline int size() const {return _workers.size();}
+
+        /*! \brief Number of hardware threads, at least 1 */
+        static inline int hardware_threads();
+
+    protected:
+        /*! \brief Loop executed by each worker */
+        inline void worker();
+
+        std::vector<std::thread> _workers; /*!< worker threads */
+        std::queue<std::function<void()>> _tasks; /*!< tasks not started yet */
+
+        std::mutex _mutex; /*!< protects _tasks, _pending and _stop */
+        std::condition_variable _task_cv; /*!< signals new tasks or stop */
+        std::condition_variable _done_cv; /*!< signals _pending reached 0 */
+
+        int _pending; /*!< tasks queued or running */
+        bool _stop;   /*!< true when workers must exit */
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline thread_pool::thread_pool(int n_threads) :
+    _pending(0),
+    _stop(false)
+{
+    if(n_threads < 1)
+        n_threads = thread_pool::hardware_threads();
+
+    for(int i=0; i < n_threads; i++)
+        _workers.push_back(std::thread(&thread_pool::worker, this));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline thread_pool::~thread_pool()
+{
+    this->wait();
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _task_cv.notify_all();
+
+    for(std::thread& t : _workers)
+        t.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void thread_pool::push(std::function<void()> task)
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _tasks.push(task);
+        _pending++;
+    }
+    _task_cv.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void thread_pool::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _done_cv.wait(lock, [this]{return _pending == 0;});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline int thread_pool::hardware_threads()
+{
+    int n = std::thread::hardware_concurrency();
+
+    return n > 0 ? n : 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void thread_pool::worker()
+{
+    std::function<void()> task;
+
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _task_cv.wait(lock, [this]{return _stop || !_tasks.empty();});
+
+            if(_stop && _tasks.empty())
+                return;
+
+            task = _tasks.front();
+            _tasks.pop();
+        }
+
+        task();
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(--_pending == 0)
+                _done_cv.notify_all();
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !THREAD_POOL_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
@@ -19,6 +19,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <cstdarg>
+#include <cstdint>
 
 #include "error.hpp"
 
@@ -269,7 +270,13 @@ inline bool key_value<K,V>::operator< (const key_value& other) const
 
 ///////////////////////////////////////////////////////////////////////////////
 
-using ifloat = key_value<int, float>; /*!< Indexed float (ifloat) definition */
+/*! \brief Index of a point in the data
+ *
+ * Points are indexed, not their first float, so 32 bits are enough for the
+ * trees and graphs while offsets of floats in the data are 64 bits (size_t) */
+using point_id = int32_t;
+
+using ifloat = key_value<point_id, float>; /*!< Indexed float (ifloat) definition */
 
 ///////////////////////////////////////////////////////////////////////////////
 
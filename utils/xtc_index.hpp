@@ -0,0 +1,233 @@
+/*============================================================================*/
+/*! \file xtc_index.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 10:02
+ *
+ *  \brief Frame offset index of .xtc and .trr files
+ *
+ *  This file contains the implementation of a class storing the byte offset,
+ *  step and time of each frame of a .xtc or .trr file. The index is built by scanning
+ *  the frame headers without decompressing the coordinates and is persisted
+ *  in a sidecar file next to the trajectory
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef XTC_INDEX_HPP
+#define XTC_INDEX_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <boost/filesystem.hpp>
+
+#include "error.hpp"
+
+#include "xdrfile/xdrfile.h"
+#include "xdrfile/xdrfile_xtc.h"
+#include "xdrfile/xdrfile_trr.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Extension appended to the trajectory name for the sidecar file */
+#define XTC_INDEX_EXT ".idx"
+
+/*! \brief Magic bytes at the start of sidecar files */
+#define XTC_INDEX_MAGIC "XTCIDX03"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Byte offsets, steps and times of the frames of a .xtc or .trr file */
+class xtc_index
+{
+    public:
+        /*! \brief Constructs an empty index */
+        xtc_index() : _n_atoms(0), _velocities(false), _file_size(0), _file_mtime(0) {}
+
+        /*! \brief Builds the index of trajfile by scanning its frame headers
+         *
+         * The coordinates of each frame are skipped over using the size of
+         * the compressed block of .xtc files, or the sizes of the arrays given
+         * in the header of .trr files, nothing is decompressed
+         * \param xdr_file file opened for reading at the first frame
+         * \return true if the whole file was scanned
+         * */
+        inline bool build(const std::string& trajfile, XDRFILE* xdr_file);
+
+        /*! \brief Loads the index from the sidecar file of trajfile
+         *
+         * \return false if there is no sidecar file or if it was built for a
+         * different version (size or modification time) of trajfile
+         * */
+        inline bool load(const std::string& trajfile);
+
+        /*! \brief Writes the index to the sidecar file of trajfile
+         *
+         * \return false if the file could not be written
+         * */
+        inline bool save(const std::string& trajfile) const;
+
+        /*! \brief Get number of frames */
+        inline size_t size() const {return _offset.size();}
+        /*! \brief Get number of atoms of each frame */
+        inline int n_atoms() const {return _n_atoms;}
+        /*! \brief Get byte offset of frame i in the file */
+        inline int64_t offset(size_t i) const {return _offset[i];}
+        /*! \brief Get step of frame i */
+        inline int step(size_t i) const {return _step[i];}
+        /*! \brief Get time of frame i */
+        inline float time(size_t i) const {return _time[i];}
+        /*! \brief Get whether frame i has positions, .trr frames can hold
+         * only velocities or forces */
+        inline bool positions(size_t i) const {return _positions[i] != 0;}
+        /*! \brief Get whether every frame with positions has velocities,
+         * only for .trr files */
+        inline bool velocities() const {return _velocities;}
+
+        /*! \brief Checks if trajfile is a .trr file, from its extension */
+        static inline bool is_trr(const std::string& trajfile)
+            {return trajfile.size() >= 4 && !trajfile.compare(trajfile.size()-4, 4, ".trr");}
+
+        /*! \brief Path of the sidecar file of trajfile */
+        static inline std::string sidecar(const std::string& trajfile)
+            {return trajfile + XTC_INDEX_EXT;}
+
+    protected:
+        /*! \brief Reads size and modification time of trajfile */
+        static inline void fingerprint(const std::string& trajfile,
+                uint64_t& size, int64_t& mtime);
+
+        std::vector<int64_t> _offset; /*!< byte offset of each frame */
+        std::vector<int> _step;       /*!< step of each frame */
+        std::vector<float> _time;     /*!< time of each frame */
+        std::vector<uint8_t> _positions; /*!< 1 if the frame has positions */
+
+        int _n_atoms; /*!< number of atoms in each frame */
+        bool _velocities; /*!< every frame with positions has velocities */
+
+        uint64_t _file_size; /*!< size of the indexed file */
+        int64_t _file_mtime; /*!< modification time of the indexed file */
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void xtc_index::fingerprint(const std::string& trajfile,
+        uint64_t& size, int64_t& mtime)
+{
+    size = boost::filesystem::file_size(trajfile);
+    mtime = boost::filesystem::last_write_time(trajfile);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline bool xtc_index::build(const std::string& trajfile, XDRFILE* xdr_file)
+{
+    int step, result, positions = 1, velocities = 0;
+    bool trr = xtc_index::is_trr(trajfile);
+    float time;
+    int64_t offset;
+
+    _offset.clear(); _step.clear(); _time.clear(); _positions.clear();
+
+    xtc_index::fingerprint(trajfile, _file_size, _file_mtime);
+    if(trr) read_trr_natoms((char*)trajfile.c_str(), &_n_atoms);
+    else read_xtc_natoms((char*)trajfile.c_str(), &_n_atoms);
+    _velocities = trr;
+
+    offset = xdrfile_tell(xdr_file);
+    while(exdrOK == (result = trr ? skip_trr(xdr_file, _n_atoms, &step, &time, &positions, &velocities) :
+                skip_xtc(xdr_file, _n_atoms, &step, &time)))
+    {
+        // Seeking past the end doesn't fail on stdio streams
+        if((uint64_t)xdrfile_tell(xdr_file) > _file_size) {
+            result = exdrFLOAT; // arrays of the last frame cut
+            break;
+        }
+
+        _offset.push_back(offset);
+        _step.push_back(step);
+        _time.push_back(time);
+        _positions.push_back(positions != 0);
+        if(positions) _velocities = _velocities && velocities;
+
+        offset = xdrfile_tell(xdr_file);
+    }
+    _velocities = _velocities && _offset.size();
+
+    // Anything else than a clean end of file means a truncated last frame
+    if(result != exdrENDOFFILE) {
+        WARNING_ERROR(trajfile + ": stopped indexing at frame " +
+                std::to_string(_offset.size()) + " (" + exdr_message[result] + ")");
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline bool xtc_index::load(const std::string& trajfile)
+{
+    std::ifstream in(xtc_index::sidecar(trajfile), std::ios_base::in | std::ios_base::binary);
+    char magic[sizeof(XTC_INDEX_MAGIC)-1];
+    uint64_t n_frames, size;
+    int64_t mtime;
+
+    if(!in) return false;
+
+    in.read(magic, sizeof(magic));
+    if(!in || memcmp(magic, XTC_INDEX_MAGIC, sizeof(magic))) return false;
+
+    in.read((char*)&_n_atoms, sizeof(_n_atoms));
+    in.read((char*)&_velocities, sizeof(_velocities));
+    in.read((char*)&_file_size, sizeof(_file_size));
+    in.read((char*)&_file_mtime, sizeof(_file_mtime));
+    in.read((char*)&n_frames, sizeof(n_frames));
+    if(!in) return false;
+
+    // The index is stale if the trajectory changed since it was built
+    xtc_index::fingerprint(trajfile, size, mtime);
+    if(size != _file_size || mtime != _file_mtime) return false;
+
+    _offset.resize(n_frames); _step.resize(n_frames); _time.resize(n_frames); _positions.resize(n_frames);
+    in.read((char*)_offset.data(), n_frames * sizeof(int64_t));
+    in.read((char*)_step.data(), n_frames * sizeof(int));
+    in.read((char*)_time.data(), n_frames * sizeof(float));
+    in.read((char*)_positions.data(), n_frames * sizeof(uint8_t));
+
+    return (bool)in;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline bool xtc_index::save(const std::string& trajfile) const
+{
+    std::ofstream out(xtc_index::sidecar(trajfile), std::ios_base::out | std::ios_base::binary);
+    uint64_t n_frames = _offset.size();
+
+    if(!out) return false;
+
+    out.write(XTC_INDEX_MAGIC, sizeof(XTC_INDEX_MAGIC)-1);
+    out.write((const char*)&_n_atoms, sizeof(_n_atoms));
+    out.write((const char*)&_velocities, sizeof(_velocities));
+    out.write((const char*)&_file_size, sizeof(_file_size));
+    out.write((const char*)&_file_mtime, sizeof(_file_mtime));
+    out.write((const char*)&n_frames, sizeof(n_frames));
+    out.write((const char*)_offset.data(), n_frames * sizeof(int64_t));
+    out.write((const char*)_step.data(), n_frames * sizeof(int));
+    out.write((const char*)_time.data(), n_frames * sizeof(float));
+    out.write((const char*)_positions.data(), n_frames * sizeof(uint8_t));
+
+    return (bool)out;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !XTC_INDEX_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
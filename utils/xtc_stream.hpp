@@ -0,0 +1,206 @@
+/*============================================================================*/
+/*! \file xtc_stream.hpp
+ *  \author Tiago LOBATO GIMENES            (tlgimenes@gmail.com)
+ *  \date 2026-10-16 12:05
+ *
+ *  \brief Streaming reader of trajlist files
+ *
+ *  This file contains the implementation of a pull based reader returning
+ *  the frames of all the files of a trajlist in fixed size batches. Batches
+ *  are decoded in a single aligned buffer reused from one batch to the next,
+ *  so the memory used doesn't depend on the length of the trajectories
+ * */
+/*============================================================================*/
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef XTC_STREAM_HPP
+#define XTC_STREAM_HPP
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdlib>
+
+#include "error.hpp"
+#include "reader_xtc.hpp"
+#include "thread_pool.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Alignment in bytes of the batch buffer */
+#define XTC_STREAM_ALIGNMENT 64
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Reads the frames of a trajlist in batches
+ *
+ * The frames are the ones read_list would return, with the same atom
+ * selection, time window, stride and subsampling of reader_xtc, and in the
+ * same order. Usage:
+ *
+ *     xtc_stream stream(home, trajlist, 1024);
+ *     while(stream.next())
+ *         process(stream.data(), stream.size(), stream.n_atoms());
+ * */
+class xtc_stream
+{
+    public:
+        /*! \brief Opens the trajlist
+         *
+         * The files are indexed but nothing is decoded yet
+         * \param batch_size maximum number of frames of a batch
+         * */
+        inline xtc_stream(const std::string& home, const std::string& trajlist,
+                size_t batch_size);
+
+        /*! \brief Frees the batch buffer */
+        inline ~xtc_stream();
+
+        /*! \brief Decodes the next batch
+         *
+         * The previous batch is overwritten, pointers returned by data() stay
+         * valid but point to the new frames
+         * \return false if there are no more frames
+         * */
+        inline bool next();
+
+        /*! \brief Restarts the stream at the first frame */
+        inline void rewind() {_position = 0; _size = 0;}
+
+        /*! \brief Get frames of the current batch, size()*n_atoms()*3 floats */
+        inline const float* data() const {return _buffer;}
+        /*! \brief Get number of frames in the current batch */
+        inline size_t size() const {return _size;}
+        /*! \brief Get number of the first frame of the current batch */
+        inline size_t first() const {return _position - _size;}
+        /*! \brief Get number of atoms of each frame */
+        inline int n_atoms() const {return _n_atoms;}
+        /*! \brief Get number of frames of the whole stream */
+        inline size_t n_frames() const {return _frames.size();}
+
+    protected:
+        /*! \brief Decodes the frames [first, first+count) of the stream in dest */
+        inline void decode(size_t first, size_t count, float* dest);
+
+        xtc_stream(const xtc_stream&) = delete;
+        xtc_stream& operator=(const xtc_stream&) = delete;
+
+        std::vector<std::string> _trajlist; /*!< files of the trajlist */
+        std::vector<xtc_index> _indexes;    /*!< frame index of each file */
+
+        /*! \brief (file, frame in the file) of each frame of the stream */
+        std::vector<std::pair<int, size_t>> _frames;
+
+        float* _buffer;      /*!< batch buffer, aligned */
+        size_t _batch_size;  /*!< maximum number of frames of a batch */
+        size_t _size;        /*!< number of frames of the current batch */
+        size_t _position;    /*!< frames returned so far */
+        int _n_atoms;        /*!< number of atoms of each frame */
+        int _n_threads;      /*!< number of threads decoding a batch */
+
+        thread_pool _pool; /*!< threads decoding the batches */
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline xtc_stream::xtc_stream(const std::string& home, const std::string& trajlist_path,
+        size_t batch_size) :
+    _buffer(NULL),
+    _batch_size(std::max(batch_size, (size_t)1)),
+    _size(0),
+    _position(0),
+    _n_atoms(0),
+    _n_threads(reader_xtc::n_threads() < 1 ? thread_pool::hardware_threads() : reader_xtc::n_threads()),
+    _pool(_n_threads)
+{
+    std::mt19937 rng(reader_xtc::seed());
+    std::vector<size_t> frames;
+    void* buffer;
+
+    // Checks if file exists
+    if(!bfs::is_regular_file(home+trajlist_path)) FATAL_ERROR(home+trajlist_path+": File not found :(");
+    reader_xtc::get_framefile_list(_trajlist, home, trajlist_path);
+
+    if(_trajlist.size() <= 0) FATAL_ERROR("File list empty :(");
+
+    reader_xtc::index_files(_trajlist, _indexes, _n_threads);
+
+    // Number of atoms in the first file is number of atoms in all the files
+    for(int i=1; i < _indexes.size(); i++) {
+        if(_indexes[i].n_atoms() != _indexes[0].n_atoms())
+            FATAL_ERROR(_trajlist[i] + ": Number of atoms differs from " + _trajlist[0]);
+    }
+    _n_atoms = reader_xtc::n_selected(_indexes[0].n_atoms());
+
+    // Frames kept, in the order of read_list
+    for(int i=0; i < _indexes.size(); i++) {
+        reader_xtc::select_frames(_indexes[i], rng, frames);
+        for(size_t f : frames) _frames.push_back(std::make_pair(i, f));
+    }
+
+    if(posix_memalign(&buffer, XTC_STREAM_ALIGNMENT, _batch_size * _n_atoms * 3 * sizeof(float)))
+        FATAL_ERROR("Cannot allocate memory for a batch of " + std::to_string(_batch_size) + " frames");
+    _buffer = (float*)buffer;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline xtc_stream::~xtc_stream()
+{
+    free(_buffer);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline bool xtc_stream::next()
+{
+    _size = std::min(_batch_size, _frames.size() - _position);
+    if(_size == 0) return false;
+
+    this->decode(_position, _size, _buffer);
+    _position += _size;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline void xtc_stream::decode(size_t first, size_t count, float* dest)
+{
+    size_t chunk = (count + _n_threads - 1) / _n_threads;
+    size_t frame_size = _n_atoms * 3;
+    size_t last = first + count;
+
+    // One task per range of frames of a same file, at most chunk frames long
+    while(first < last)
+    {
+        int file = _frames[first].first;
+        size_t end = first;
+        float* chunk_dest = dest;
+
+        while(end < last && end - first < chunk && _frames[end].first == file) end++;
+
+        _pool.push([this, file, first, end, chunk_dest]() {
+            std::vector<size_t> frames(end - first);
+
+            for(size_t i=first; i < end; i++) frames[i - first] = _frames[i].second;
+
+            reader_xtc::decode_frames(_trajlist[file], _indexes[file],
+                    frames.data(), frames.size(), chunk_dest);
+        });
+
+        dest += (end - first) * frame_size;
+        first = end;
+    }
+
+    _pool.wait();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif /* !XTC_STREAM_HPP */
+
+///////////////////////////////////////////////////////////////////////////////
@@ -44,6 +44,20 @@
 
 #define _FILE_OFFSET_BITS  64
 
+/* Memory mapped input is available on POSIX systems */
+#if (defined __unix__ || defined __APPLE__) && !defined XDRFILE_NO_MMAP
+#  define XDRFILE_HAVE_MMAP
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+/* SSE2 is used to byte swap arrays read in bulk */
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 /* get fixed-width types if we are using ANSI C99 */
 #ifdef HAVE_STDINT_H
 #  include <stdint.h>
@@ -132,10 +146,15 @@ struct XDR
 		/* two next routines are not 64-bit IO safe - don't use! */
 		unsigned int (*x_getpostn) (XDR *__xdrs); 
 		int (*x_setpostn) (XDR *__xdrs, unsigned int __pos);
+		/* pointer to len bytes inside the stream buffer, NULL if the
+		 * stream has no buffer (stdio) */
+		int32_t *(*x_inline) (XDR *__xdrs, unsigned int __len);
 		void (*x_destroy) (XDR *__xdrs); 
 	} 
     *x_ops;	    
 	char *x_private;
+	char *x_base;     /* start of the buffer for memory streams */
+	size_t x_handy;   /* bytes left in the buffer for memory streams */
 };
 
 static int  xdr_char        (XDR *xdrs, char *ip);
@@ -149,11 +168,14 @@ static int  xdr_double      (XDR *xdrs, double *ip);
 static int  xdr_string      (XDR *xdrs, char **ip, unsigned int maxsize);
 static int  xdr_opaque      (XDR *xdrs, char *cp, unsigned int cnt);
 static void xdrstdio_create (XDR *xdrs, FILE *fp, enum xdr_op xop);
+static void xdrmem_create   (XDR *xdrs, char *addr, size_t size, enum xdr_op xop);
 
 #define xdr_getpos(xdrs)                                \
         (*(xdrs)->x_ops->x_getpostn)(xdrs)
 #define xdr_setpos(xdrs, pos)                           \
         (*(xdrs)->x_ops->x_setpostn)(xdrs, pos)
+#define xdr_inline(xdrs, len)                           \
+        (*(xdrs)->x_ops->x_inline)(xdrs, len)
 #define xdr_destroy(xdrs)                                       \
         do {                                                    \
                 if ((xdrs)->x_ops->x_destroy)                   \
@@ -181,6 +203,8 @@ struct XDRFILE
     int      buf1size; /**< Current allocated length of buf1          */    
     int *    buf2;     /**< Buffer for internal use                   */
     int      buf2size; /**< Current allocated length of buf2          */ 
+    char *   map;      /**< Mapped file contents, NULL for stdio      */
+    size_t   mapsize;  /**< Length of the mapping in bytes            */
 };
 
 
@@ -232,7 +256,56 @@ xdrfile_open(const char *path, const char *mode)
 	xdrstdio_create((XDR *)(xfp->xdr),xfp->fp,xdrmode);
 	xfp->buf1 = xfp->buf2 = NULL;
 	xfp->buf1size = xfp->buf2size = 0;
+	xfp->map = NULL;
+	xfp->mapsize = 0;
+	return xfp;
+}
+
+XDRFILE *
+xdrfile_open_mmap(const char *path)
+{
+#if (defined XDRFILE_HAVE_MMAP && !defined HAVE_RPC_XDR_H)
+	XDRFILE *xfp;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if((fd=open(path,O_RDONLY))<0)
+		return NULL;
+	if(fstat(fd,&st)<0 || st.st_size<=0)
+    {
+		close(fd);
+		return NULL;
+	}
+	map=mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd); /* the mapping keeps its own reference to the file */
+	if(map==MAP_FAILED)
+		return NULL;
+	/* frames are decoded front to back, let the kernel read ahead */
+	madvise(map,(size_t)st.st_size,MADV_SEQUENTIAL);
+
+	if((xfp=(XDRFILE *)malloc(sizeof(XDRFILE)))==NULL)
+    {
+		munmap(map,(size_t)st.st_size);
+		return NULL;
+	}
+	if((xfp->xdr=(XDR *)malloc(sizeof(XDR)))==NULL) 
+    {
+		munmap(map,(size_t)st.st_size);
+		free(xfp);
+		return NULL;
+	}
+	xfp->fp=NULL;
+	xfp->mode='r';
+	xfp->map=(char *)map;
+	xfp->mapsize=(size_t)st.st_size;
+	xdrmem_create((XDR *)(xfp->xdr),xfp->map,xfp->mapsize,XDR_DECODE);
+	xfp->buf1 = xfp->buf2 = NULL;
+	xfp->buf1size = xfp->buf2size = 0;
 	return xfp;
+#else
+	return NULL;
+#endif
 }
 
 int 
@@ -246,7 +319,12 @@ xdrfile_close(XDRFILE *xfp)
 			xdr_destroy((XDR *)(xfp->xdr));
 		free(xfp->xdr);
 		/* close the file */
-		ret=fclose(xfp->fp);
+#ifdef XDRFILE_HAVE_MMAP
+		if(xfp->map)
+			ret=munmap(xfp->map,xfp->mapsize);
+		else
+#endif
+			ret=fclose(xfp->fp);
 		if(xfp->buf1size)
 			free(xfp->buf1);
 		if(xfp->buf2size)
@@ -258,11 +336,126 @@ xdrfile_close(XDRFILE *xfp)
 
 
 
+int64_t
+xdrfile_tell(XDRFILE *xfp)
+{
+#if (defined XDRFILE_HAVE_MMAP && !defined HAVE_RPC_XDR_H)
+	if(xfp->map)
+		return (int64_t)(((XDR *)(xfp->xdr))->x_private - xfp->map);
+	return (int64_t)ftello(xfp->fp);
+#else
+	return (int64_t)ftell(xfp->fp);
+#endif
+}
+
+int
+xdrfile_seek(XDRFILE *xfp, int64_t offset, int whence)
+{
+#if (defined XDRFILE_HAVE_MMAP && !defined HAVE_RPC_XDR_H)
+	XDR *xdrs = (XDR *)(xfp->xdr);
+
+	if(xfp->map)
+    {
+		if(whence == SEEK_CUR)
+			offset += xdrfile_tell(xfp);
+		else if(whence == SEEK_END)
+			offset += xfp->mapsize;
+		if(offset < 0 || offset > (int64_t)xfp->mapsize)
+			return exdrENDOFFILE;
+		xdrs->x_private = xfp->map + offset;
+		xdrs->x_handy = xfp->mapsize - offset;
+		return exdrOK;
+	}
+	return fseeko(xfp->fp,(off_t)offset,whence) < 0 ? exdrENDOFFILE : exdrOK;
+#else
+	return fseek(xfp->fp,(long)offset,whence) < 0 ? exdrENDOFFILE : exdrOK;
+#endif
+}
+
+
+
+/*
+ * xdrfile_swap_words - converts n big-endian 32 bit words from src to host
+ * order in dst. dst and src may be the same array.
+ */
+static void
+xdrfile_swap_words(void *dst, const void *src, size_t n)
+{
+	const unsigned char *s = (const unsigned char *)src;
+	unsigned char *d = (unsigned char *)dst;
+	int one = 1;
+	uint32_t w;
+	size_t i = 0;
+
+	if (*(char *)&one == 0)
+	{
+		/* big endian host, nothing to swap */
+		if (dst != src)
+			memmove(dst, src, n * 4);
+		return;
+	}
+#ifdef __SSE2__
+	/* 4 words at a time: swap the bytes of each 16 bit half, then the
+	 * halves of each word */
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i * 4));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+		_mm_storeu_si128((__m128i *)(d + i * 4), v);
+	}
+#endif
+	for (; i < n; i++)
+	{
+		memcpy(&w, s + i * 4, 4);
+		w = (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24);
+		memcpy(d + i * 4, &w, 4);
+	}
+}
+
+/*
+ * xdrfile_read_words - reads ndata 32 bit words in one block
+ *
+ * Memory mapped streams are converted straight from the mapping, stdio
+ * streams with a single fread. Returns the number of words read, or -1 when
+ * the stream has to be read element by element.
+ */
+static int
+xdrfile_read_words(void *ptr, int ndata, XDRFILE *xfp)
+{
+#ifndef HAVE_RPC_XDR_H
+	XDR *xdrs = (XDR *)(xfp->xdr);
+	const void *src;
+	size_t n;
+
+	if (ndata <= 0 || xdrs->x_op != XDR_DECODE)
+		return -1;
+	if (xfp->map != NULL)
+	{
+		if ((src = xdr_inline(xdrs, (unsigned int)ndata * 4)) == NULL)
+			return -1; /* not enough bytes left, read what is there */
+		xdrfile_swap_words(ptr, src, (size_t)ndata);
+		return ndata;
+	}
+	if (xfp->fp != NULL)
+	{
+		n = fread(ptr, 4, (size_t)ndata, xfp->fp);
+		xdrfile_swap_words(ptr, ptr, n);
+		return (int)n;
+	}
+#endif
+	return -1;
+}
+
 int 
 xdrfile_read_int(int *ptr, int ndata, XDRFILE* xfp) 
 {
 	int i=0;
 
+	if ((i = xdrfile_read_words(ptr, ndata, xfp)) >= 0)
+		return i;
+	i = 0;
+
 	/* read write is encoded in the XDR struct */
 	while(i<ndata && xdr_int((XDR *)(xfp->xdr),ptr+i))
 		i++;
@@ -403,6 +596,10 @@ int
 xdrfile_read_float(float *ptr, int ndata, XDRFILE* xfp) 
 {
 	int i=0;
+
+	if (sizeof(float) == 4 && (i = xdrfile_read_words(ptr, ndata, xfp)) >= 0)
+		return i;
+	i = 0;
 	/* read write is encoded in the XDR struct */
 	while(i<ndata && xdr_float((XDR *)(xfp->xdr),ptr+i))
 		i++;
@@ -673,21 +870,20 @@ encodeints(int buf[], int num_of_ints, int num_of_bits,
 /*
  * decodebits - decode number from buf using specified number of bits
  * 
- * extract the number of bits from the array buf and construct an integer
- * from it. Return that value.
+ * extract the number of bits from the byte array cbuf and construct an
+ * integer from it. Return that value. buf[0-2] hold the decoder state
+ * (byte count, bits left and last byte read).
  *
  */
 
 static int 
-decodebits(int buf[], int num_of_bits) 
+decodebits(int buf[], const unsigned char *cbuf, int num_of_bits) 
 {
 
     int cnt, num; 
     unsigned int lastbits, lastbyte;
-    unsigned char * cbuf;
     int mask = (1 << num_of_bits) -1;
 
-    cbuf = ((unsigned char *)buf) + 3 * sizeof(*buf);
     cnt = buf[0];
     lastbits = (unsigned int) buf[1];
     lastbyte = (unsigned int) buf[2];
@@ -727,7 +923,7 @@ decodebits(int buf[], int num_of_bits)
  */
 
 static void 
-decodeints(int buf[], int num_of_ints, int num_of_bits,
+decodeints(int buf[], const unsigned char *cbuf, int num_of_ints, int num_of_bits,
 		   unsigned int sizes[], int nums[])
 {
 
@@ -738,12 +934,12 @@ decodeints(int buf[], int num_of_ints, int num_of_bits,
 	num_of_bytes = 0;
 	while (num_of_bits > 8)
     {
-		bytes[num_of_bytes++] = decodebits(buf, 8);
+		bytes[num_of_bytes++] = decodebits(buf, cbuf, 8);
 		num_of_bits -= 8;
 	}
 	if (num_of_bits > 0)
     {
-		bytes[num_of_bytes++] = decodebits(buf, num_of_bits);
+		bytes[num_of_bytes++] = decodebits(buf, cbuf, num_of_bits);
 	}
 	for (i = num_of_ints-1; i > 0; i--) 
     {
@@ -761,6 +957,24 @@ decodeints(int buf[], int num_of_ints, int num_of_bits,
 }
     
 
+/*
+ * xdrfile_inline_bytes - pointer to the next len bytes of the stream
+ *
+ * For memory backed streams (see xdrfile_open_mmap) this returns a pointer
+ * into the mapped file and advances the stream past the bytes and their XDR
+ * padding, so compressed data can be decoded without copying it. Returns
+ * NULL, without advancing, when the stream cannot do this.
+ */
+static const unsigned char *
+xdrfile_inline_bytes(XDRFILE *xfp, unsigned int len)
+{
+	unsigned int rndup = (len + 3) & ~3U;
+
+	if (rndup == 0)
+		return NULL;
+	return (const unsigned char *)xdr_inline((XDR *)(xfp->xdr), rndup);
+}
+
 static const int magicints[] = 
 {
     0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 10, 12, 16, 20, 25, 32, 40, 50, 64,
@@ -776,6 +990,257 @@ static const int magicints[] =
 /* note that magicints[FIRSTIDX-1] == 0 */
 #define LASTIDX (sizeof(magicints) / sizeof(*magicints))
 
+/*
+ * Fast coordinate decoder
+ *
+ * Same bit stream as decodebits()/decodeints(), but the bits are taken from
+ * a 64-bit accumulator refilled with a whole big-endian word at a time, and
+ * the small integers of a triplet are split with 64-bit divisions instead of
+ * the byte by byte long division whenever they fit in 64 bits. The integer
+ * coordinates of the whole frame are decoded first and converted to floats
+ * in a single loop the compiler can vectorize. The results are bit-identical
+ * to the reference decoder, which stays available as a fallback.
+ */
+
+static int xdrfile_fast_decompress = 1;
+
+int
+xdrfile_set_fast_decompress(int enable)
+{
+	int previous = xdrfile_fast_decompress;
+
+	xdrfile_fast_decompress = enable;
+	return previous;
+}
+
+struct bitreader
+{
+	const unsigned char *cbuf;    /* compressed bytes */
+	size_t cnt;                   /* next byte to load */
+	size_t len;                   /* number of compressed bytes */
+	uint64_t acc;                 /* loaded bits, the valid ones at the bottom */
+	int nbits;                    /* number of valid bits in acc */
+};
+
+#if defined __GNUC__
+#  define XDR_BSWAP64(x) __builtin_bswap64(x)
+#else
+static uint64_t
+XDR_BSWAP64(uint64_t x)
+{
+	x = ((x & 0x00000000ffffffffULL) << 32) | (x >> 32);
+	x = ((x & 0x0000ffff0000ffffULL) << 16) | ((x >> 16) & 0x0000ffff0000ffffULL);
+	return ((x & 0x00ff00ff00ff00ffULL) << 8) | ((x >> 8) & 0x00ff00ff00ff00ffULL);
+}
+#endif
+
+/* Loads whole bytes until at least 56 bits are valid, at most 63. The
+ * callers rely on it: bitreader_get never asks for more than 32 bits, so a
+ * single refill always covers a request */
+static void
+bitreader_refill(struct bitreader *br)
+{
+	int take = (63 - br->nbits) >> 3;
+	uint64_t word;
+
+	if (take <= 0)
+		return;
+	if (br->cnt + 8 <= br->len)
+	{
+		memcpy(&word, br->cbuf + br->cnt, 8);
+		word = XDR_BSWAP64(word);
+		br->acc = (br->acc << (take * 8)) | (word >> (64 - take * 8));
+		br->cnt += take;
+		br->nbits += take * 8;
+		return;
+	}
+	/* tail of the block, bytes past its end read as zeros */
+	for (; take > 0; take--)
+	{
+		br->acc = (br->acc << 8) | (br->cnt < br->len ? br->cbuf[br->cnt] : 0);
+		br->cnt++;
+		br->nbits += 8;
+	}
+}
+
+/* Same as decodebits() for num_of_bits <= 32 */
+static unsigned int
+bitreader_get(struct bitreader *br, int num_of_bits)
+{
+	if (br->nbits < num_of_bits)
+		bitreader_refill(br);
+	br->nbits -= num_of_bits;
+	return (unsigned int)((br->acc >> br->nbits) & ((1ULL << num_of_bits) - 1));
+}
+
+/* Same as decodeints() for 3 integers */
+static void
+bitreader_getints(struct bitreader *br, int num_of_bits,
+				  const unsigned int sizes[], int nums[])
+{
+	int bytes[32];
+	int i, j, num_of_bytes, p, num;
+	uint64_t x, v;
+	int rest, full;
+
+	if (num_of_bits <= 64)
+	{
+		/* decodeints() takes the bytes of the value least significant
+		 * first: read them as one big-endian number and reverse it */
+		rest = num_of_bits & 7;
+		full = num_of_bits >> 3;
+		if (num_of_bits > 32)
+		{
+			x = bitreader_get(br, num_of_bits - 32);
+			x = (x << 32) | bitreader_get(br, 32);
+		}
+		else
+			x = bitreader_get(br, num_of_bits);
+		if (full == 0)
+			v = x;
+		else
+		{
+			v = XDR_BSWAP64((x >> rest) << (64 - full * 8));
+			if (rest)
+				v |= (x & ((1U << rest) - 1)) << (full * 8);
+		}
+		nums[2] = (int)(v % sizes[2]);
+		v /= sizes[2];
+		nums[1] = (int)(v % sizes[1]);
+		nums[0] = (int)(v / sizes[1]);
+		return;
+	}
+
+	/* wider values, byte by byte as decodeints() */
+	bytes[1] = bytes[2] = bytes[3] = 0;
+	num_of_bytes = 0;
+	while (num_of_bits > 8)
+	{
+		bytes[num_of_bytes++] = bitreader_get(br, 8);
+		num_of_bits -= 8;
+	}
+	if (num_of_bits > 0)
+		bytes[num_of_bytes++] = bitreader_get(br, num_of_bits);
+	for (i = 2; i > 0; i--)
+	{
+		num = 0;
+		for (j = num_of_bytes-1; j >=0; j--)
+		{
+			num = (num << 8) | bytes[j];
+			p = num / sizes[i];
+			bytes[j] = p;
+			num = num - p * sizes[i];
+		}
+		nums[i] = num;
+	}
+	nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+}
+
+/* Decodes the compressed block cbuf of lsize coordinates in ptr, using buf1
+ * for the integer coordinates. The other parameters are the ones read from
+ * the header by xdrfile_decompress_coord_float() */
+static void
+decompress_coord_float_fast(float *ptr, int *buf1, int lsize,
+							const unsigned char *cbuf, size_t len,
+							const int minint[], const unsigned int sizeint[],
+							const unsigned int bitsizeint[], unsigned int bitsize,
+							int smallidx, float inv_precision)
+{
+	struct bitreader br;
+	int smallnum, smaller, is_smaller, run, i, k, tmp, flag;
+	int *thiscoord, prevcoord[3];
+	unsigned int sizesmall[3];
+	int n3 = lsize * 3;
+
+	br.cbuf = cbuf;
+	br.cnt = 0;
+	br.len = len;
+	br.acc = 0;
+	br.nbits = 0;
+
+	tmp = smallidx - 1;
+	tmp = (FIRSTIDX>tmp) ? FIRSTIDX : tmp;
+	smaller = magicints[tmp] / 2;
+	smallnum = magicints[smallidx] / 2;
+	sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+
+	run = 0;
+	i = 0;
+	while (i < lsize)
+	{
+		thiscoord = buf1 + i * 3;
+
+		if (bitsize == 0)
+		{
+			thiscoord[0] = bitreader_get(&br, bitsizeint[0]);
+			thiscoord[1] = bitreader_get(&br, bitsizeint[1]);
+			thiscoord[2] = bitreader_get(&br, bitsizeint[2]);
+		}
+		else
+			bitreader_getints(&br, bitsize, sizeint, thiscoord);
+
+		i++;
+		thiscoord[0] += minint[0];
+		thiscoord[1] += minint[1];
+		thiscoord[2] += minint[2];
+
+		prevcoord[0] = thiscoord[0];
+		prevcoord[1] = thiscoord[1];
+		prevcoord[2] = thiscoord[2];
+
+		flag = bitreader_get(&br, 1);
+		is_smaller = 0;
+		if (flag == 1)
+		{
+			run = bitreader_get(&br, 5);
+			is_smaller = run % 3;
+			run -= is_smaller;
+			is_smaller--;
+		}
+		/* buf1 holds the coordinates in output order, so the first two
+		 * atoms of a run are stored swapped */
+		for (k = 0; k < run; k += 3)
+		{
+			thiscoord += 3;
+			bitreader_getints(&br, smallidx, sizesmall, thiscoord);
+			i++;
+			thiscoord[0] += prevcoord[0] - smallnum;
+			thiscoord[1] += prevcoord[1] - smallnum;
+			thiscoord[2] += prevcoord[2] - smallnum;
+			if (k == 0)
+			{
+				tmp = thiscoord[0]; thiscoord[0] = prevcoord[0];
+				thiscoord[-3] = prevcoord[0] = tmp;
+				tmp = thiscoord[1]; thiscoord[1] = prevcoord[1];
+				thiscoord[-2] = prevcoord[1] = tmp;
+				tmp = thiscoord[2]; thiscoord[2] = prevcoord[2];
+				thiscoord[-1] = prevcoord[2] = tmp;
+			}
+			else
+			{
+				prevcoord[0] = thiscoord[0];
+				prevcoord[1] = thiscoord[1];
+				prevcoord[2] = thiscoord[2];
+			}
+		}
+		smallidx += is_smaller;
+		if (is_smaller < 0)
+		{
+			smallnum = smaller;
+			smaller = (smallidx > FIRSTIDX) ? magicints[smallidx - 1] / 2 : 0;
+		}
+		else if (is_smaller > 0)
+		{
+			smaller = smallnum;
+			smallnum = magicints[smallidx] / 2;
+		}
+		sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+	}
+
+	for (i = 0; i < n3; i++)
+		ptr[i] = buf1[i] * inv_precision;
+}
+
 /* Compressed coordinate routines - modified from the original
  * implementation by Frans v. Hoesel to make them threadsafe.
  */
@@ -793,6 +1258,7 @@ xdrfile_decompress_coord_float(float     *ptr,
 	float *lfp, inv_precision;
 	int tmp, *thiscoord,  prevcoord[3];
 	unsigned int bitsize;
+	const unsigned char *cbuf;
   
     bitsizeint[0] = 0;
     bitsizeint[1] = 0;
@@ -876,12 +1342,23 @@ xdrfile_decompress_coord_float(float     *ptr,
   
 	if (xdrfile_read_int(buf2,1,xfp) == 0)
 		return 0;
-	if (xdrfile_read_opaque((char *)&(buf2[3]),(unsigned int)buf2[0],xfp) == 0)
-		return 0;
+	/* decode in place when the stream is memory backed, copy otherwise */
+	if ((cbuf = xdrfile_inline_bytes(xfp, (unsigned int)buf2[0])) == NULL)
+	{
+		if (xdrfile_read_opaque((char *)&(buf2[3]),(unsigned int)buf2[0],xfp) == 0)
+			return 0;
+		cbuf = (const unsigned char *)&(buf2[3]);
+	}
+	inv_precision = 1.0 / * precision;
+	if (xdrfile_fast_decompress)
+	{
+		decompress_coord_float_fast(ptr, buf1, lsize, cbuf, (size_t)buf2[0], minint,
+									sizeint, bitsizeint, bitsize, smallidx, inv_precision);
+		return *size;
+	}
 	buf2[0] = buf2[1] = buf2[2] = 0;
-  
+
 	lfp = ptr;
-	inv_precision = 1.0 / * precision;
 	run = 0;
 	i = 0;
 	lip = buf1;
@@ -891,13 +1368,13 @@ xdrfile_decompress_coord_float(float     *ptr,
     
 		if (bitsize == 0) 
         {
-			thiscoord[0] = decodebits(buf2, bitsizeint[0]);
-			thiscoord[1] = decodebits(buf2, bitsizeint[1]);
-			thiscoord[2] = decodebits(buf2, bitsizeint[2]);
+			thiscoord[0] = decodebits(buf2, cbuf, bitsizeint[0]);
+			thiscoord[1] = decodebits(buf2, cbuf, bitsizeint[1]);
+			thiscoord[2] = decodebits(buf2, cbuf, bitsizeint[2]);
 		}
         else
         {
-			decodeints(buf2, 3, bitsize, sizeint, thiscoord);
+			decodeints(buf2, cbuf, 3, bitsize, sizeint, thiscoord);
 		}
     
 		i++;
@@ -909,11 +1386,11 @@ xdrfile_decompress_coord_float(float     *ptr,
 		prevcoord[1] = thiscoord[1];
 		prevcoord[2] = thiscoord[2];
     
-		flag = decodebits(buf2, 1);
+		flag = decodebits(buf2, cbuf, 1);
 		is_smaller = 0;
 		if (flag == 1) 
         {
-			run = decodebits(buf2, 5);
+			run = decodebits(buf2, cbuf, 5);
 			is_smaller = run % 3;
 			run -= is_smaller;
 			is_smaller--;
@@ -923,7 +1400,7 @@ xdrfile_decompress_coord_float(float     *ptr,
 			thiscoord += 3;
 			for (k = 0; k < run; k+=3) 
             {
-				decodeints(buf2, 3, smallidx, sizesmall, thiscoord);
+				decodeints(buf2, cbuf, 3, smallidx, sizesmall, thiscoord);
 				i++;
 				thiscoord[0] += prevcoord[0] - smallnum;
 				thiscoord[1] += prevcoord[1] - smallnum;
@@ -981,6 +1458,35 @@ xdrfile_decompress_coord_float(float     *ptr,
 	return *size;
 }
 
+int
+xdrfile_skip_coord_float(int *size, float *precision, XDRFILE *xfp)
+{
+	int minmax[6], smallidx, lsize, bytecnt;
+
+	if(xfp==NULL)
+		return -1;
+	if(xdrfile_read_int(&lsize,1,xfp)==0)
+		return -1; /* return if we could not read size */
+	*size = lsize;
+	/* Dont bother with compression for three atoms or less */
+	if(lsize<=9)
+    {
+		if(xdrfile_seek(xfp,(int64_t)lsize*3*sizeof(float),SEEK_CUR)!=exdrOK)
+			return -1;
+		return lsize;
+	}
+	/* precision, minint, maxint and smallidx precede the byte count */
+	if(xdrfile_read_float(precision,1,xfp)!=1 ||
+	   xdrfile_read_int(minmax,6,xfp)!=6 ||
+	   xdrfile_read_int(&smallidx,1,xfp)!=1 ||
+	   xdrfile_read_int(&bytecnt,1,xfp)!=1)
+		return -1;
+	/* compressed bytes are padded to full xdr units */
+	if(xdrfile_seek(xfp,(int64_t)((bytecnt+3) & ~3),SEEK_CUR)!=exdrOK)
+		return -1;
+	return lsize;
+}
+
 int
 xdrfile_compress_coord_float(float   *ptr,
 							 int      size,
@@ -1289,6 +1795,7 @@ xdrfile_decompress_coord_double(double     *ptr,
 	double *lfp, inv_precision;
 	float float_prec, tmpdata[30];
 	int tmp, *thiscoord,  prevcoord[3];
+	const unsigned char *cbuf;
 	unsigned int bitsize;
   
     bitsizeint[0] = 0;
@@ -1376,8 +1883,13 @@ xdrfile_decompress_coord_double(double     *ptr,
   
 	if (xdrfile_read_int(buf2,1,xfp) == 0)
 		return 0;
-	if (xdrfile_read_opaque((char *)&(buf2[3]),(unsigned int)buf2[0],xfp) == 0)
-		return 0;
+	/* decode in place when the stream is memory backed, copy otherwise */
+	if ((cbuf = xdrfile_inline_bytes(xfp, (unsigned int)buf2[0])) == NULL)
+	{
+		if (xdrfile_read_opaque((char *)&(buf2[3]),(unsigned int)buf2[0],xfp) == 0)
+			return 0;
+		cbuf = (const unsigned char *)&(buf2[3]);
+	}
 	buf2[0] = buf2[1] = buf2[2] = 0;
   
 	lfp = ptr;
@@ -1391,11 +1903,11 @@ xdrfile_decompress_coord_double(double     *ptr,
     
 		if (bitsize == 0) 
         {
-			thiscoord[0] = decodebits(buf2, bitsizeint[0]);
-			thiscoord[1] = decodebits(buf2, bitsizeint[1]);
-			thiscoord[2] = decodebits(buf2, bitsizeint[2]);
+			thiscoord[0] = decodebits(buf2, cbuf, bitsizeint[0]);
+			thiscoord[1] = decodebits(buf2, cbuf, bitsizeint[1]);
+			thiscoord[2] = decodebits(buf2, cbuf, bitsizeint[2]);
 		} else {
-			decodeints(buf2, 3, bitsize, sizeint, thiscoord);
+			decodeints(buf2, cbuf, 3, bitsize, sizeint, thiscoord);
 		}
     
 		i++;
@@ -1407,11 +1919,11 @@ xdrfile_decompress_coord_double(double     *ptr,
 		prevcoord[1] = thiscoord[1];
 		prevcoord[2] = thiscoord[2];
     
-		flag = decodebits(buf2, 1);
+		flag = decodebits(buf2, cbuf, 1);
 		is_smaller = 0;
 		if (flag == 1) 
         {
-			run = decodebits(buf2, 5);
+			run = decodebits(buf2, cbuf, 5);
 			is_smaller = run % 3;
 			run -= is_smaller;
 			is_smaller--;
@@ -1421,7 +1933,7 @@ xdrfile_decompress_coord_double(double     *ptr,
 			thiscoord += 3;
 			for (k = 0; k < run; k+=3) 
             {
-				decodeints(buf2, 3, smallidx, sizesmall, thiscoord);
+				decodeints(buf2, cbuf, 3, smallidx, sizesmall, thiscoord);
 				i++;
 				thiscoord[0] += prevcoord[0] - smallnum;
 				thiscoord[1] += prevcoord[1] - smallnum;
@@ -2519,6 +3031,7 @@ static int xdrstdio_getbytes (XDR *, char *, unsigned int);
 static int xdrstdio_putbytes (XDR *, char *, unsigned int);
 static unsigned int xdrstdio_getpos (XDR *);
 static int xdrstdio_setpos (XDR *, unsigned int);
+static int32_t *xdrstdio_inline (XDR *, unsigned int);
 static void xdrstdio_destroy (XDR *);
 
 /*
@@ -2532,6 +3045,7 @@ static const struct xdr_ops xdrstdio_ops =
 		xdrstdio_putbytes,     	/* serialize counted bytes */
 		xdrstdio_getpos,		/* get offset in the stream */
 		xdrstdio_setpos,		/* set offset in the stream */
+		xdrstdio_inline,		/* no buffer to point into */
 		xdrstdio_destroy,		/* destroy stream */
 	};
 
@@ -2547,6 +3061,8 @@ xdrstdio_create (XDR *xdrs, FILE *file, enum xdr_op op)
 
 	xdrs->x_ops = (struct xdr_ops *) &xdrstdio_ops;
 	xdrs->x_private = (char *) file;
+	xdrs->x_base = NULL;
+	xdrs->x_handy = 0;
 }
 
 /*
@@ -2612,6 +3128,139 @@ xdrstdio_setpos (XDR *xdrs, unsigned int pos)
 	return fseek ((FILE *) xdrs->x_private, pos, 0) < 0 ? 0 : 1;
 }
 
+static int32_t *
+xdrstdio_inline (XDR *xdrs, unsigned int len)
+{
+	/* stdio streams have no buffer we can hand out */
+	return NULL;
+}
+
+
+
+static int xdrmem_getlong (XDR *, int32_t *);
+static int xdrmem_putlong (XDR *, int32_t *);
+static int xdrmem_getbytes (XDR *, char *, unsigned int);
+static int xdrmem_putbytes (XDR *, char *, unsigned int);
+static unsigned int xdrmem_getpos (XDR *);
+static int xdrmem_setpos (XDR *, unsigned int);
+static int32_t *xdrmem_inline (XDR *, unsigned int);
+static void xdrmem_destroy (XDR *);
+
+/*
+ * Ops vector for memory type XDR, used on top of memory mapped files
+ */
+static const struct xdr_ops xdrmem_ops =
+	{
+		xdrmem_getlong,		/* deserialize a long int */
+		xdrmem_putlong,		/* serialize a long int */
+		xdrmem_getbytes,		/* deserialize counted bytes */
+		xdrmem_putbytes,		/* serialize counted bytes */
+		xdrmem_getpos,		/* get offset in the stream */
+		xdrmem_setpos,		/* set offset in the stream */
+		xdrmem_inline,		/* pointer into the buffer */
+		xdrmem_destroy,		/* destroy stream */
+	};
+
+/*
+ * Initialize a memory xdr stream.
+ * x_base is the start of the buffer, x_private the current position and
+ * x_handy the number of bytes left after it.
+ */
+static void
+xdrmem_create (XDR *xdrs, char *addr, size_t size, enum xdr_op op)
+{
+	xdrs->x_op = op;
+	xdrs->x_ops = (struct xdr_ops *) &xdrmem_ops;
+	xdrs->x_private = xdrs->x_base = addr;
+	xdrs->x_handy = size;
+}
+
+static void
+xdrmem_destroy (XDR *xdrs)
+{
+	/* the buffer belongs to the caller */
+}
+
+static int
+xdrmem_getlong (XDR *xdrs, int32_t *lp)
+{
+	int32_t mycopy;
+
+	if (xdrs->x_handy < 4)
+		return 0;
+	memcpy (&mycopy, xdrs->x_private, 4);
+	*lp = (int32_t) xdr_ntohl (mycopy);
+	xdrs->x_private += 4;
+	xdrs->x_handy -= 4;
+	return 1;
+}
+
+static int
+xdrmem_putlong (XDR *xdrs, int32_t *lp)
+{
+	int32_t mycopy = xdr_htonl (*lp);
+
+	if (xdrs->x_handy < 4)
+		return 0;
+	memcpy (xdrs->x_private, &mycopy, 4);
+	xdrs->x_private += 4;
+	xdrs->x_handy -= 4;
+	return 1;
+}
+
+static int
+xdrmem_getbytes (XDR *xdrs, char *addr, unsigned int len)
+{
+	if (xdrs->x_handy < len)
+		return 0;
+	memcpy (addr, xdrs->x_private, len);
+	xdrs->x_private += len;
+	xdrs->x_handy -= len;
+	return 1;
+}
+
+static int
+xdrmem_putbytes (XDR *xdrs, char *addr, unsigned int len)
+{
+	if (xdrs->x_handy < len)
+		return 0;
+	memcpy (xdrs->x_private, addr, len);
+	xdrs->x_private += len;
+	xdrs->x_handy -= len;
+	return 1;
+}
+
+static unsigned int
+xdrmem_getpos (XDR *xdrs)
+{
+	return (unsigned int) (xdrs->x_private - xdrs->x_base);
+}
+
+static int
+xdrmem_setpos (XDR *xdrs, unsigned int pos)
+{
+	size_t size = (xdrs->x_private - xdrs->x_base) + xdrs->x_handy;
+
+	if (pos > size)
+		return 0;
+	xdrs->x_private = xdrs->x_base + pos;
+	xdrs->x_handy = size - pos;
+	return 1;
+}
+
+static int32_t *
+xdrmem_inline (XDR *xdrs, unsigned int len)
+{
+	int32_t *buf;
+
+	if (xdrs->x_handy < len)
+		return NULL;
+	buf = (int32_t *) xdrs->x_private;
+	xdrs->x_private += len;
+	xdrs->x_handy -= len;
+	return buf;
+}
+
 
 
 #endif /* HAVE_RPC_XDR_H not defined */
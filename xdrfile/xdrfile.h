@@ -78,6 +78,8 @@
 #ifndef _XDRFILE_H_
 #define _XDRFILE_H_
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" 
 {
@@ -123,10 +125,28 @@ extern "C"
 	 *
 	 */
 	XDRFILE *
-	xdrfile_open    (const char *    path, 
+	xdrfile_open    (const char *    path,
 					 const char *    mode);
 
 
+	/*! \brief Open a portable binary file for reading through a memory map
+	 *
+	 *  The whole file is mapped read-only and the XDR stream decodes directly
+	 *  from the mapped pages instead of going through one fread() per 32-bit
+	 *  word. The kernel is told the access will be sequential, so read-ahead
+	 *  stays ahead of the decoder. The returned handle is used exactly like
+	 *  one returned by xdrfile_open() in read mode.
+	 *
+	 *  \param path  Full or relative path (including name) of the file
+	 *
+	 *  \return Pointer to abstract xdr file datatype, or NULL if the file could
+	 *          not be mapped (not found, empty, or memory maps unsupported on
+	 *          this platform). Callers should fall back to xdrfile_open().
+	 */
+	XDRFILE *
+	xdrfile_open_mmap(const char *   path);
+
+
 	/*! \brief Close a previously opened portable binary file, just like fclose()
 	 *
 	 *  Use this routine much like calls to the standard library function
@@ -141,6 +161,33 @@ extern "C"
 	xdrfile_close   (XDRFILE *       xfp);
 
 
+	/*! \brief Current byte offset in a file opened for reading, like ftello()
+	 *
+	 *  Unlike the position of the XDR stream this is 64-bit safe.
+	 *
+	 *  \param xfp  Pointer to an abstract XDRFILE datatype
+	 *
+	 *  \return     Offset from the start of the file, or -1 on error.
+	 */
+	int64_t
+	xdrfile_tell    (XDRFILE *       xfp);
+
+
+	/*! \brief Move to a byte offset in a file opened for reading, like fseeko()
+	 *
+	 *  \param xfp     Pointer to an abstract XDRFILE datatype
+	 *  \param offset  Offset relative to whence
+	 *  \param whence  SEEK_SET, SEEK_CUR or SEEK_END
+	 *
+	 *  \return        exdrOK on success, exdrENDOFFILE if the offset is
+	 *                 outside the file.
+	 */
+	int
+	xdrfile_seek    (XDRFILE *       xfp,
+					 int64_t         offset,
+					 int             whence);
+
+
 
 
 	/*! \brief Read one or more \a char type variable(s) 
@@ -550,6 +597,47 @@ extern "C"
 
 
 
+	/*! \brief Skip compressed coordinates in a XDR file
+	 *
+	 *  This routine reads the header of a block of coordinates written by
+	 *  xdrfile_compress_coord_float() and moves past the compressed bytes
+	 *  without decoding them. It is much cheaper than decompressing, so it can
+	 *  be used to scan a file for the position of its frames.
+	 *
+	 *  \param ncoord     Number of coordinate triplets in the block on return
+	 *  \param precision  Precision of the compression on return, unchanged
+	 *                    for blocks of 3 atoms or less which are stored
+	 *                    uncompressed.
+	 *  \param xfp        Handle to portably binary file
+	 *
+	 *  \return           Number of coordinate triplets skipped. If this is
+	 *                    negative, an error occured.
+	 */
+	int
+	xdrfile_skip_coord_float(int *       ncoord,
+							 float *     precision,
+							 XDRFILE *   xfp);
+
+
+
+
+	/*! \brief Select the decoder of xdrfile_decompress_coord_float()
+	 *
+	 *  The fast decoder reads the compressed bits 64 at a time and is used by
+	 *  default. The reference decoder gives the same coordinates, bit for bit,
+	 *  and is kept as a fallback. The setting is global to the library, change
+	 *  it before starting threads that read files.
+	 *
+	 *  \param enable     1 to use the fast decoder, 0 for the reference one
+	 *
+	 *  \return           The previous setting
+	 */
+	int
+	xdrfile_set_fast_decompress(int enable);
+
+
+
+
 	/*! \brief Compress coordiates in a double array to XDR file
 	 *
 	 *  This routine will perform \a lossy compression on the three-dimensional
@@ -31,6 +31,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -496,3 +497,32 @@ int read_trr(XDRFILE *xd,int natoms,int *step,float *t,float *lambda,
 	return do_trn(xd,1,step,t,lambda,box,&natoms,x,v,f);
 }
 
+int skip_trr(XDRFILE *xd,int natoms,int *step,float *t,int *bPositions,
+			 int *bVelocities)
+/* Skip subsequent frames */
+{
+	t_trnheader sh;
+	int64_t start,size;
+	int result;
+
+	start = xdrfile_tell(xd);
+	if ((result = do_trnheader(xd,1,&sh)) != exdrOK)
+		/* nothing could be read: clean end of file */
+		return (xdrfile_tell(xd) == start && result == exdrINT) ? exdrENDOFFILE : result;
+	if (sh.natoms != natoms)
+		return exdrHEADER;
+
+	*step = sh.step;
+	*t = sh.tf;
+	*bPositions = (sh.x_size != 0);
+	*bVelocities = (sh.v_size != 0);
+
+	/* sizes are given in bytes of the file */
+	size = (int64_t)sh.box_size + sh.vir_size + sh.pres_size +
+		sh.x_size + sh.v_size + sh.f_size;
+	if (xdrfile_seek(xd,xdrfile_tell(xd) + size,SEEK_SET) != exdrOK)
+		return exdrENDOFFILE;
+
+	return exdrOK;
+}
+
@@ -51,6 +51,12 @@ extern "C" {
   extern int read_trr(XDRFILE *xd,int natoms,int *step,float *t,float *lambda,
 		      matrix box,rvec *x,rvec *v,rvec *f);
 
+  /* Read the header of the next frame and move past its arrays without
+     reading them. *bPositions is set if the frame has positions and
+     *bVelocities if it has velocities */
+  extern int skip_trr(XDRFILE *xd,int natoms,int *step,float *t,
+		      int *bPositions,int *bVelocities);
+
   /* Write a frame to xtc file */
   extern int write_trr(XDRFILE *xd,int natoms,int step,float t,float lambda,
 		       matrix box,rvec *x,rvec *v,rvec *f);
@@ -118,6 +118,26 @@ int read_xtc(XDRFILE *xd,
 	return exdrOK;
 }
 
+int skip_xtc(XDRFILE *xd,
+			 int natoms,int *step,float *time)
+/* Skip subsequent frames */
+{
+	int result;
+	float prec;
+	matrix box;
+  
+	if ((result = xtc_header(xd,&natoms,step,time,TRUE)) != exdrOK)
+		return result;
+	
+	if (xdrfile_read_float(box[0],DIM*DIM,xd) != DIM*DIM)
+		return exdrFLOAT;
+	
+	if (xdrfile_skip_coord_float(&natoms,&prec,xd) < 0)
+		return exdr3DX;
+  
+	return exdrOK;
+}
+
 int write_xtc(XDRFILE *xd,
 			  int natoms,int step,float time,
 			  matrix box,rvec *x,float prec)
@@ -51,6 +51,10 @@ extern "C" {
   extern int read_xtc(XDRFILE *xd,int natoms,int *step,float *time,
 		      matrix box,rvec *x,float *prec);
   
+  /* Read the header of the next frame and move past its coordinates
+     without decompressing them */
+  extern int skip_xtc(XDRFILE *xd,int natoms,int *step,float *time);
+  
   /* Write a frame to xtc file */
   extern int write_xtc(XDRFILE *xd,
 		       int natoms,int step,float time,